@@ -0,0 +1,213 @@
+/*
+alarm sets the ADC window comparator levels for channels and pushes the alarms that latch
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+The compare is done by the ADC as each channel is converted, the ISR only latches the 
+first hit of a channel. When the command line is idle the main loop calls AlarmPush(), 
+which sends each new latch once (like a subscription frame).
+*/
+
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "../lib/parse.h"
+#include "../lib/adc_bsd.h"
+#include "../lib/json_bsd.h"
+#include "alarm.h"
+
+// token index is the ADC_WINCM_t
+static const char alarm_tokens[] PROGMEM = "off\0below\0above\0inside\0outside\0";
+
+// /alarm channels,off|below|above|inside|outside[,level[,level]]
+static const struct Arg_Schema alarm_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_TOKEN, 0, 0, alarm_tokens},
+    {ARG_TYPE_UINT32, 0, 65535, NULL}, // oversampled channels can be up to 16 bits
+    {ARG_TYPE_UINT32, 0, 65535, NULL}
+};
+
+// /ack channels
+static const struct Arg_Schema ack_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL}
+};
+
+static uint8_t alarm_listed; // latched alarms when the list started, so each pass has the same items
+static uint8_t alarm_push_ch = ADC_CHANNELS; // ADC_CHANNELS when no alarm is going out
+
+/* /0/alarm all|0..7|a-b|0xHH,off|below|above|inside|outside[,level[,level]] 
+   below and above have one level, inside and outside have the low and high level. */
+void Alarm(void)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !typeArguments(alarm_schema, 4) )
+        {
+            printf_P(PSTR("{\"err\":\"AlarmArg%dOutOfRng\"}\r\n"), arg_err_index);
+            initCommandBuffer();
+            return;
+        }
+        ADC_WINCM_t mode = (ADC_WINCM_t) arg_val[1].token;
+        uint8_t levels = (mode >= ADC_WINCM_INSIDE_gc) ? 2 : ( (mode == ADC_WINCM_NONE_gc) ? 0 : 1);
+        if (arg_count != (levels + 2))
+        {
+            printf_P(PSTR("{\"err\":\"AlarmLevelCount\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        uint16_t lo = (levels) ? (uint16_t) arg_val[2].u32 : 0;
+        uint16_t hi = (levels == 2) ? (uint16_t) arg_val[3].u32 : lo;
+        if (hi < lo)
+        {
+            printf_P(PSTR("{\"err\":\"AlarmWindowLoHi\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+        {
+            if (arg_val[0].set & (1<<ch))
+            {
+                // the ISR loads these when it selects the channel
+                ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+                {
+                    adc_alarm[ch].mode = mode;
+                    adc_alarm[ch].lo = lo;
+                    adc_alarm[ch].hi = hi;
+                }
+            }
+        }
+        adc_alarm_ack( (uint8_t) arg_val[0].set); // new levels start without a latch
+        command_done = 11;
+    }
+    else if ( (command_done == 11) || (command_done == 12) )
+    {
+        AlarmList();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+/* /0/alarm? gives the channels with a window or a latch
+   {"alarm":[{"ch":"0","w":"above","lo":"3000","hi":"3000"},{"ch":"2","w":"outside","lo":"1000","hi":"3000","t":"1290457","v":"3012"}]} 
+   where "t" is the ticksFine() time stamp and "v" the reading of the latched hit */
+void AlarmList(void)
+{
+    if ( (command_done == 10) || (command_done == 11) )
+    {
+        alarm_listed = adc_alarm_latched;
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 12;
+    }
+    if ( (command_done == 12) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("alarm"));
+        json_arr_begin();
+        for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+        {
+            uint8_t latched = alarm_listed & (1<<ch);
+            if ( !adc_alarm[ch].mode && !latched ) continue;
+            json_obj_begin();
+            json_key_P(PSTR("ch"));
+            json_uint(ch);
+            json_key_P(PSTR("w"));
+            json_str_P(token_word(alarm_tokens, adc_alarm[ch].mode));
+            json_key_P(PSTR("lo"));
+            json_uint(adc_alarm[ch].lo);
+            json_key_P(PSTR("hi"));
+            json_uint(adc_alarm[ch].hi);
+            if (latched)
+            { // the ISR does not change a latched alarm
+                json_key_P(PSTR("t"));
+                json_uint(adc_alarm[ch].stamp);
+                json_key_P(PSTR("v"));
+                json_int(adc_alarm[ch].value);
+            }
+            json_obj_end();
+        }
+        json_arr_end();
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+/* /0/ack all|0..7|a-b|0xHH clears the latched alarms of channels so they can latch again */
+void Ack(void)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !typeArguments(ack_schema, 1) )
+        {
+            printf_P(PSTR("{\"err\":\"AckChOutOfRng\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        adc_alarm_ack( (uint8_t) arg_val[0].set);
+        command_done = 11;
+    }
+    else if ( (command_done == 11) )
+    {
+        printf_P(PSTR("{\"latched\":\"%u\"}\r\n"), adc_alarm_latched);
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+uint8_t alarm_pushing(void)
+{
+    return (alarm_push_ch < ADC_CHANNELS);
+}
+
+// an alarm that latched is pushed once {"alarm":"2","t":"1290457","v":"3012"}
+void AlarmPush(void)
+{
+    if ( !alarm_pushing() )
+    {
+        uint8_t fresh = adc_alarm_new;
+        if (!fresh) return;
+        for (alarm_push_ch = ADC_CH_ADC0; !(fresh & (1<<alarm_push_ch)); alarm_push_ch++);
+        json_start(JSON_QUOTE_NUMBERS);
+    }
+
+    json_pass();
+    json_obj_begin();
+    json_key_P(PSTR("alarm"));
+    json_uint(alarm_push_ch);
+    json_key_P(PSTR("t"));
+    json_uint(adc_alarm[alarm_push_ch].stamp);
+    json_key_P(PSTR("v"));
+    json_int(adc_alarm[alarm_push_ch].value);
+    json_obj_end();
+    json_eol();
+    if (json_blocked()) return; // next pass when the serial buffer has room
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_alarm_new &= ~(1<<alarm_push_ch);
+    }
+    alarm_push_ch = ADC_CHANNELS;
+}
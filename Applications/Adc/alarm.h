@@ -0,0 +1,10 @@
+#ifndef Alarm_H
+#define Alarm_H
+
+extern void Alarm(void);
+extern void AlarmList(void);
+extern void Ack(void);
+extern void AlarmPush(void);
+extern uint8_t alarm_pushing(void);
+
+#endif // Alarm_H
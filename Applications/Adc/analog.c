@@ -32,103 +32,255 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 #include "../lib/timers_bsd.h"
 #include "../lib/uart0_bsd.h"
 #include "../lib/references.h"
+#include "../lib/json_bsd.h"
 #include "analog.h"
 
 static unsigned long serial_print_started_at;
 
-static uint8_t adc_arg_index;
+// each argument is a channel
+static const struct Arg_Schema adc_schema[] PROGMEM = {
+    {ARG_TYPE_UINT32, ADC_CH_ADC0, (ADC_CHANNELS+ADC_CH_MGR_MAX_NOT_A_CH), NULL}
+};
 
-/* return adc corrected values */
-void Analogf(unsigned long serial_print_delay_ticks)
+// or one argument is a batch of channels, e.g., all, 0-7 or 0xF0
+static const struct Arg_Schema adc_batch_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL}
+};
+
+// channels in the order of the reply
+static uint8_t adc_rply_ch[ADC_CHANNELS];
+static uint8_t adc_rply_ch_count;
+static uint8_t adc_batch_mask; // zero when channels were given as a list
+
+// check and convert the arguments into adc_rply_ch[], an error reply is given if they are not valid
+static uint8_t adc_arguments(void)
 {
-    if ( (command_done == 10) )
+    adc_batch_mask = 0;
+    adc_rply_ch_count = 0;
+    if ( (arg_count == 1) && is_arg_batch(0) )
     {
-        // check that arguments are digit in the range 0..7
-        for (adc_arg_index=0; adc_arg_index < arg_count; adc_arg_index++) 
+        if ( !typeArguments(adc_batch_schema, 1) )
         {
-            if ( ( !( isdigit(arg[adc_arg_index][0]) ) ) || (atoi(arg[adc_arg_index]) < ADC_CH_ADC0) || (atoi(arg[adc_arg_index]) > (ADC_CHANNELS+ADC_CH_MGR_MAX_NOT_A_CH)) )
-            {
-                printf_P(PSTR("{\"err\":\"AdcChOutOfRng\"}\r\n"));
-                initCommandBuffer();
-                return;
-            }
+            printf_P(PSTR("{\"err\":\"AdcChOutOfRng\"}\r\n"));
+            initCommandBuffer();
+            return 0;
         }
-        // if references failed to loaded show an error
-        if (ref_loaded == VREF_LOADED_ERR)
+        adc_batch_mask = (uint8_t) arg_val[0].set;
+        for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
         {
-            printf_P(PSTR("{\"err\":\"AdcRefNotLoaded\"}\r\n"));
-            initCommandBuffer();
-            return;
+            if (adc_batch_mask & (1<<ch)) adc_rply_ch[adc_rply_ch_count++] = ch;
         }
-
-        // if calibrations failed to loaded show an error
-        if (cal_loaded == CALIBRATE_LOADED_ERR)
+    }
+    else
+    {
+        // check that arguments are digit in the range 0..7 (and convert them once)
+        if ( !typeArguments(adc_schema, 1) )
         {
-            printf_P(PSTR("{\"err\":\"AdcCalNotLoaded\"}\r\n"));
+            printf_P(PSTR("{\"err\":\"AdcChOutOfRng\"}\r\n"));
             initCommandBuffer();
-            return;
+            return 0;
         }
-
-        // print in steps otherwise the serial buffer will fill and block the program from running
-        serial_print_started_at = tickAtomic();
-        printf_P(PSTR("{"));
-        adc_arg_index= 0;
-        command_done = 11;
-    }
-    else if ( (command_done == 11) )
-    { // use the channel as an index in the JSON reply
-        uint8_t arg_indx_channel = atoi(arg[adc_arg_index]);
-        switch (arg_indx_channel)
-        {
-            case ADC_CH_ADC0:
-            case ADC_CH_ADC1:
-            case ADC_CH_ADC2:
-            case ADC_CH_ADC3:
-            case ADC_CH_ADC4:
-            case ADC_CH_ADC5:
-            case ADC_CH_ADC6:
-            case ADC_CH_ADC7:
-                printf_P(PSTR("\"ADC%s\":"),arg[adc_arg_index]);
-                break;
-
-            default:
+        // only the local channels are converted
+        for (uint8_t i = 0; i < arg_count; i++)
+        {
+            if (arg_val[i].u32 > ADC_CH_ADC7)
+            {
                 printf_P(PSTR("{\"err\":\"AdcNotChannel\"}\r\n"));
                 initCommandBuffer();
-                return;
+                return 0;
+            }
+            adc_rply_ch[adc_rply_ch_count++] = (uint8_t) arg_val[i].u32;
         }
-        command_done = 20; 
     }
-    else if ( (command_done == 20) )
+
+    // if references failed to loaded show an error
+    if (ref_loaded == VREF_LOADED_ERR)
     {
-        uint8_t arg_indx_channel = atoi(arg[adc_arg_index]);
+        printf_P(PSTR("{\"err\":\"AdcRefNotLoaded\"}\r\n"));
+        initCommandBuffer();
+        return 0;
+    }
+
+    // if calibrations failed to loaded show an error
+    if (cal_loaded == CALIBRATE_LOADED_ERR)
+    {
+        printf_P(PSTR("{\"err\":\"AdcCalNotLoaded\"}\r\n"));
+        initCommandBuffer();
+        return 0;
+    }
+    return 1;
+}
+
+// a list of channels gives {"ADC0":"v0","ADC3":"v3"}, a batch gives {"m":"9","ADC":["v0","v3"]}
+static void adc_reply_begin(void)
+{
+    json_pass();
+    json_obj_begin();
+    if (adc_batch_mask)
+    {
+        json_key_P(PSTR("m"));
+        json_uint(adc_batch_mask);
+        json_key_P(PSTR("ADC"));
+        json_arr_begin();
+    }
+}
+
+static void adc_reply_key(uint8_t channel)
+{
+    if (!adc_batch_mask) json_key_idx_P(PSTR("ADC"), channel);
+}
 
-        // There are values from 0 to 4095 for 4096 slots where each reperesents 1/4096 of the reference.
-        // Slot 4095 also includes higher values e.g., VREF*(4095/4096) and up.
-        int temp_adc = adcAtomic((ADC_CH_t) arg_indx_channel);
-        float *ptr_temp_ref = adcConfMap[arg_indx_channel].ref;
-        float temp_ref = *ptr_temp_ref;
-        float temp_ch_calibration_value = adcConfMap[arg_indx_channel].calibration;
-        float corrected = temp_adc*temp_ref*temp_ch_calibration_value;
-        printf_P(PSTR("\"%1.4f\""), corrected);
+static void adc_reply_end(void)
+{
+    if (adc_batch_mask) json_arr_end();
+    json_obj_end();
+    json_eol();
+}
 
-        if ( (adc_arg_index+1) >= arg_count) 
+// delay between replies, returns 1 when the reply should be repeated
+static uint8_t adc_repeat(unsigned long serial_print_delay_ticks)
+{
+    if (CommandQueued())
+    { // a pipelined command line ends the repeat, as a Rx char does when not pipelined
+        initCommandBuffer();
+        return 0;
+    }
+    unsigned long kRuntime= elapsed(&serial_print_started_at);
+    return ((kRuntime) > (serial_print_delay_ticks));
+}
+
+// the burst that a filtered reply is made from, taken once so every channel in the reply is from it
+static struct Adc_Snapshot analog_burst;
+
+// filtered readings (see /filt) as corrected volts or as counts
+static void analog_filtered(unsigned long serial_print_delay_ticks, uint8_t volts)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !adc_arguments() ) return;
+
+        // the reply is sent in passes that fill the serial buffer without blocking the program
+        serial_print_started_at = tickAtomic();
+        json_start(JSON_QUOTE_NUMBERS);
+        adcSnapshot(&analog_burst);
+        command_done = 20;
+    }
+    else if ( (command_done == 20) )
+    {
+        adc_reply_begin();
+        for (uint8_t i = 0; i < adc_rply_ch_count; i++)
         {
-            printf_P(PSTR("}\r\n"));
-            command_done = 21;
+            uint8_t arg_indx_channel = adc_rply_ch[i];
+            adc_reply_key(arg_indx_channel);
+
+            // only correct the value that goes out on this pass
+            int32_t temp_adc = 0;
+            fixed_micro_t corrected = 0;
+            if (json_pending())
+            {
+                // There are values from 0 to 4095 for 4096 slots where each reperesents 1/4096 of the reference.
+                // Slot 4095 also includes higher values e.g., VREF*(4095/4096) and up.
+                // A wider (oversampled) reading has 2^(bits-12) slots for each of those.
+                temp_adc = analog_burst.filtered[arg_indx_channel];
+                if (volts) corrected = adc_micro_units( (ADC_CH_t) arg_indx_channel, temp_adc); // volts, or degrees C
+            }
+            if (volts)
+            {
+                json_fixed(corrected, FIXED_MICRO_PLACES, 4);
+            }
+            else
+            {
+                json_int(temp_adc);
+            }
         }
-        else
+        adc_reply_end();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        command_done = 21;
+    }
+    else if ( (command_done == 21) ) 
+    { // delay between JSON printing
+        if (adc_repeat(serial_print_delay_ticks))
         {
-            printf_P(PSTR(","));
-            adc_arg_index++;
-            command_done = 11;
+            json_start(JSON_QUOTE_NUMBERS);
+            serial_print_started_at = tickAtomic();
+            adcSnapshot(&analog_burst);
+            command_done = 20; /* This keeps looping output forever (until a Rx char anyway) */
         }
     }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+/* return adc corrected values */
+void Analogf(unsigned long serial_print_delay_ticks)
+{
+    analog_filtered(serial_print_delay_ticks, 1);
+}
+
+/* return adc filtered intiger values */
+void Analogc(unsigned long serial_print_delay_ticks)
+{
+    analog_filtered(serial_print_delay_ticks, 0);
+}
+
+/* return adc intiger values, single conversions unless a /rate runs then the raw readings of its last scan */
+void Analogd(unsigned long serial_print_delay_ticks)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !adc_arguments() ) return;
+
+        // the reply is sent in passes that fill the serial buffer without blocking the program
+        serial_print_started_at = tickAtomic();
+        json_start(JSON_QUOTE_NUMBERS);
+        if (adc_event_rate) adcSnapshot(&analog_burst);
+        command_done = 20;
+    }
+    else if ( (command_done == 20) )
+    {
+        adc_reply_begin();
+        for (uint8_t i = 0; i < adc_rply_ch_count; i++)
+        {
+            uint8_t arg_indx_channel = adc_rply_ch[i];
+            adc_reply_key(arg_indx_channel);
+
+            // only convert for the value that goes out on this pass
+            int32_t temp_adc = 0;
+            if (json_pending() && adc_event_rate)
+            {
+                temp_adc = analog_burst.adc[arg_indx_channel]; // the events never leave the ADC free for a single conversion
+            }
+            else if (json_pending())
+            {
+                uint8_t oldSREG = SREG;
+                cli();           // clear the global interrupt mask.
+                if (adc_auto_conversion) 
+                {
+                    SREG = oldSREG;  // restore global interrupt if they were enabled
+                    return; // don't do single conversions when auto_conversion is running
+                }
+                temp_adc = adcSingle((ADC_CH_t) arg_indx_channel);
+                SREG = oldSREG;  // restore global interrupt if they were enabled
+            }
+
+            // There are values from 0 to 4095 for 4096 slots where each reperesents 1/4096 of the reference.
+            // Slot 4095 also includes higher values e.g., VREF*(4095/4096) and up. An oversampled channel is wider.
+            json_int(temp_adc);
+        }
+        adc_reply_end();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        command_done = 21;
+    }
     else if ( (command_done == 21) ) 
     { // delay between JSON printing
-        unsigned long kRuntime= elapsed(&serial_print_started_at);
-        if ((kRuntime) > (serial_print_delay_ticks))
+        if (adc_repeat(serial_print_delay_ticks))
         {
-            command_done = 10; /* This keeps looping output forever (until a Rx char anyway) */
+            json_start(JSON_QUOTE_NUMBERS);
+            serial_print_started_at = tickAtomic();
+            if (adc_event_rate) adcSnapshot(&analog_burst);
+            command_done = 20; /* This keeps looping output forever (until a Rx char anyway) */
         }
     }
     else
@@ -137,107 +289,311 @@ void Analogf(unsigned long serial_print_delay_ticks)
     }
 }
 
-/* return adc intiger values */
-void Analogd(unsigned long serial_print_delay_ticks)
+// /acc channels,samples,bits where samples is 1,2,4..128 and bits is 12..16
+static const struct Arg_Schema acc_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_UINT32, 1, 128, NULL},
+    {ARG_TYPE_UINT32, ADC_BITS, ADC_BITS_MAX, NULL}
+};
+
+/* /0/acc? gives {"acc":["1","16",..],"bits":["12","14",..]}
+   /0/acc all|0..7|a-b|0xHH,1..128,12..16 sets the hardware accumulation and the reading width for channels, 
+   e.g., /0/acc 0-3,16,14 averages 16 samples to a 14 bit reading. */
+void Accumulation(void)
 {
     if ( (command_done == 10) )
     {
-        // check that arguments are digit in the range 0..7
-        for (adc_arg_index=0; adc_arg_index < arg_count; adc_arg_index++) 
+        if (arg_count == 3)
         {
-            if ( ( !( isdigit(arg[adc_arg_index][0]) ) ) || (atoi(arg[adc_arg_index]) < ADC_CH_ADC0) || (atoi(arg[adc_arg_index]) > (ADC_CHANNELS+ADC_CH_MGR_MAX_NOT_A_CH)) )
+            if ( !typeArguments(acc_schema, 3) )
             {
-                printf_P(PSTR("{\"err\":\"AdcChOutOfRng\"}\r\n"));
+                printf_P(PSTR("{\"err\":\"AccArg%dOutOfRng\"}\r\n"), arg_err_index);
+                initCommandBuffer();
+                return;
+            }
+            uint8_t samples = (uint8_t) arg_val[1].u32;
+            if (samples & (samples - 1))
+            {
+                printf_P(PSTR("{\"err\":\"AccNotPow2\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
+            ADC_SAMPNUM_t sampnum = ADC_SAMPNUM_NONE_gc;
+            while (samples >>= 1) sampnum++;
+            if (arg_val[2].u32 > adc_acc_bits_max(sampnum))
+            {
+                printf_P(PSTR("{\"err\":\"AccBitsNeedSamples\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
+            ADC_SAMPNUM_t old_sampnum[ADC_CHANNELS];
+            uint8_t old_bits[ADC_CHANNELS];
+            for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+            {
+                old_sampnum[ch] = adcConfMap[ch].sampnum;
+                old_bits[ch] = adcConfMap[ch].bits;
+                if (arg_val[0].set & (1<<ch))
+                {
+                    // the ISR reads both when it sets up the channel
+                    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+                    {
+                        adcConfMap[ch].sampnum = sampnum;
+                        adcConfMap[ch].bits = (uint8_t) arg_val[2].u32;
+                    }
+                    adc_cal_update( (ADC_CH_t) ch); // microvolts for each count follow the width
+                }
+            }
+            if ( !adc_event_retime() )
+            { // the accumulation takes longer than the event period, put it back
+                for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+                {
+                    if ( !(arg_val[0].set & (1<<ch)) ) continue;
+                    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+                    {
+                        adcConfMap[ch].sampnum = old_sampnum[ch];
+                        adcConfMap[ch].bits = old_bits[ch];
+                    }
+                    adc_cal_update( (ADC_CH_t) ch);
+                }
+                printf_P(PSTR("{\"err\":\"RateNotMade\"}\r\n"));
                 initCommandBuffer();
                 return;
             }
         }
-        // if references failed to loaded show an error
-        if (ref_loaded == VREF_LOADED_ERR)
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 11;
+    }
+    else if ( (command_done == 11) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("acc"));
+        json_arr_begin();
+        for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
         {
-            printf_P(PSTR("{\"err\":\"AdcRefNotLoaded\"}\r\n"));
-            initCommandBuffer();
-            return;
+            json_uint(1U << adcConfMap[ch].sampnum);
         }
-
-        // if calibrations failed to loaded show an error
-        if (cal_loaded == CALIBRATE_LOADED_ERR)
+        json_arr_end();
+        json_key_P(PSTR("bits"));
+        json_arr_begin();
+        for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
         {
-            printf_P(PSTR("{\"err\":\"AdcCalNotLoaded\"}\r\n"));
-            initCommandBuffer();
-            return;
+            json_uint(adcConfMap[ch].bits);
         }
+        json_arr_end();
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
 
-        // print in steps otherwise the serial buffer will fill and block the program from running
-        serial_print_started_at = tickAtomic();
-        printf_P(PSTR("{"));
-        adc_arg_index= 0;
+static const struct Arg_Schema rate_schema[] PROGMEM = {
+    {ARG_TYPE_UINT32, 0, ADC_EVENT_RATE_MAX, NULL}
+};
+
+/* /0/rate? gives {"rate":"1000"}, zero is the burst every ADC_DELAY_MILSEC
+   /0/rate 0|16..4000 sets the conversions per second for each channel, they are started by a timer event
+   so the sample time does not jitter with the main loop. */
+void Rate(void)
+{
+    if ( (command_done == 10) )
+    {
+        if (arg_count == 1)
+        {
+            if ( !typeArguments(rate_schema, 1) || ( arg_val[0].u32 && (arg_val[0].u32 < ADC_EVENT_RATE_MIN) ) )
+            {
+                printf_P(PSTR("{\"err\":\"RateOutOfRng\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
+            if (arg_val[0].u32)
+            {
+                if ( !enable_ADC_event_conversion( (uint16_t) arg_val[0].u32) )
+                {
+                    printf_P(PSTR("{\"err\":\"RateNotMade\"}\r\n"));
+                    initCommandBuffer();
+                    return;
+                }
+            }
+            else if (adc_event_rate)
+            {
+                disable_ADC_event_conversion(); // main loop goes back to bursts
+            }
+        }
         command_done = 11;
     }
     else if ( (command_done == 11) )
-    { // use the channel as an index in the JSON reply
-        uint8_t arg_indx_channel = atoi(arg[adc_arg_index]);
-        switch (arg_indx_channel)
-        {
-            case ADC_CH_ADC0:
-            case ADC_CH_ADC1:
-            case ADC_CH_ADC2:
-            case ADC_CH_ADC3:
-            case ADC_CH_ADC4:
-            case ADC_CH_ADC5:
-            case ADC_CH_ADC6:
-            case ADC_CH_ADC7:
-                printf_P(PSTR("\"ADC%s\":"),arg[adc_arg_index]);
-                break;
-
-            default:
-                printf_P(PSTR("\"err\":\"AdcNotChannel\"}\r\n"));
+    {
+        printf_P(PSTR("{\"rate\":\"%u\"}\r\n"), adc_event_rate);
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+// token index is the ADC_FILTER_t
+static const char filt_tokens[] PROGMEM = "none\0ema\0box\0med\0";
+
+// /filt channels,none|ema|box|med[,n]
+static const struct Arg_Schema filt_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_TOKEN, 0, 0, filt_tokens},
+    {ARG_TYPE_UINT32, 1, ADC_FILTER_HIST, NULL}
+};
+
+/* /0/filt? gives {"filt":["none","ema",..],"n":["0","4",..]}
+   /0/filt all|0..7|a-b|0xHH,none|ema|box|med[,n] sets the filter of channels, ema has alpha 1/2^n (n is 1..8), 
+   box averages n readings (2, 4, 8 or 16), med is the median of n readings (3 or 5). */
+void Filter(void)
+{
+    if ( (command_done == 10) )
+    {
+        if (arg_count)
+        {
+            if ( !typeArguments(filt_schema, 3) )
+            {
+                printf_P(PSTR("{\"err\":\"FiltArg%dOutOfRng\"}\r\n"), arg_err_index);
+                initCommandBuffer();
+                return;
+            }
+            ADC_FILTER_t kind = (ADC_FILTER_t) arg_val[1].token;
+            uint8_t n = (arg_count == 3) ? (uint8_t) arg_val[2].u32 : 0;
+            uint8_t ok = 0;
+            if (kind == ADC_FILTER_NONE)
+            {
+                ok = (arg_count == 2);
+            }
+            else if (kind == ADC_FILTER_EMA)
+            {
+                ok = (n && (n <= 8));
+            }
+            else if (kind == ADC_FILTER_BOX)
+            {
+                ok = ( (n >= 2) && !(n & (n - 1)) );
+                uint8_t shift = 0;
+                while (n >>= 1) shift++;
+                n = shift; // the filter keeps the power of two
+            }
+            else
+            {
+                ok = ( (n == 3) || (n == 5) );
+            }
+            if (!ok)
+            {
+                printf_P(PSTR("{\"err\":\"FiltNotValid\"}\r\n"));
                 initCommandBuffer();
                 return;
+            }
+            for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+            {
+                if (arg_val[0].set & (1<<ch)) adc_filter_set( (ADC_CH_t) ch, kind, n);
+            }
         }
-        command_done = 20; 
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 11;
     }
-    else if ( (command_done == 20) )
+    else if ( (command_done == 11) )
     {
-        uint8_t arg_indx_channel = atoi(arg[adc_arg_index]);
-
-        int temp_adc = 0;
-        uint8_t oldSREG = SREG;
-        cli();           // clear the global interrupt mask.
-        if (adc_auto_conversion) 
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("filt"));
+        json_arr_begin();
+        for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
         {
-            SREG = oldSREG;  // restore global interrupt if they were enabled
-            return; // don't do single conversions when auto_conversion is running
+            json_str_P(token_word(filt_tokens, adc_filter[ch].kind));
         }
-        else
+        json_arr_end();
+        json_key_P(PSTR("n"));
+        json_arr_begin();
+        for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
         {
-            temp_adc = adcSingle((ADC_CH_t) arg_indx_channel);
-            SREG = oldSREG;  // restore global interrupt if they were enabled
+            uint8_t n = adc_filter[ch].n;
+            if (adc_filter[ch].kind == ADC_FILTER_BOX) n = 1 << n;
+            json_uint( (adc_filter[ch].kind == ADC_FILTER_NONE) ? 0 : n);
         }
+        json_arr_end();
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
 
-        // There are values from 0 to 4095 for 4096 slots where each reperesents 1/4096 of the reference.
-        // Slot 4095 also includes higher values e.g., VREF*(4095/4096) and up.
-        printf_P(PSTR("\"%d\""), temp_adc);
+// /scan channels,0|1|2|4|..|128
+static const struct Arg_Schema scan_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_UINT32, 0, ADC_SCAN_DIV_MAX, NULL}
+};
 
-        if ( (adc_arg_index+1) >= arg_count) 
+/* /0/scan? gives the scan plan (channels in the order they are converted, grouped by reference) and divisors, e.g., 
+   {"plan":["0","1","4","5","2","3"],"div":["1","1","8","8","1","1","0","0"]}
+   /0/scan all|0..7|a-b|0xHH,0|1|2|4|..|128 converts the channels on every nth burst, zero takes them out of the scan. */
+void Scan(void)
+{
+    if ( (command_done == 10) )
+    {
+        if (arg_count)
         {
-            printf_P(PSTR("}\r\n"));
-            command_done = 21;
+            if ( !typeArguments(scan_schema, 2) || (arg_val[1].u32 & (arg_val[1].u32 - 1)) )
+            {
+                printf_P(PSTR("{\"err\":\"ScanOutOfRng\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
+            uint8_t old_div[ADC_CHANNELS];
+            for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+            {
+                old_div[ch] = adc_scan_div[ch];
+            }
+            adc_scan_set( (uint8_t) arg_val[0].set, (uint8_t) arg_val[1].u32);
+            if ( !adc_event_retime() )
+            { // the event period is from the channels in the plan, put the divisors back
+                for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+                {
+                    if (arg_val[0].set & (1<<ch)) adc_scan_set( (1<<ch), old_div[ch]);
+                }
+                if ( !adc_event_retime() ) disable_ADC_event_conversion(); // it was running with the old plan
+                printf_P(PSTR("{\"err\":\"RateNotMade\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
         }
-        else
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 11;
+    }
+    else if ( (command_done == 11) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("plan"));
+        json_arr_begin();
+        for (uint8_t i = 0; i < adc_scan_len; i++)
         {
-            printf_P(PSTR(","));
-            adc_arg_index++;
-            command_done = 11;
+            json_uint(adc_scan_plan[i]);
         }
-    }
-    else if ( (command_done == 21) ) 
-    { // delay between JSON printing
-        unsigned long kRuntime= elapsed(&serial_print_started_at);
-        if ((kRuntime) > (serial_print_delay_ticks))
+        json_arr_end();
+        json_key_P(PSTR("div"));
+        json_arr_begin();
+        for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
         {
-            command_done = 10; /* This keeps looping output forever (until a Rx char anyway) */
+            json_uint(adc_scan_div[ch]);
         }
+        json_arr_end();
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
     }
     else
     {
@@ -3,5 +3,10 @@
 
 extern void Analogf(unsigned long);
 extern void Analogd(unsigned long);
+extern void Analogc(unsigned long);
+extern void Accumulation(void);
+extern void Rate(void);
+extern void Filter(void);
+extern void Scan(void);
 
 #endif // Analog_H 
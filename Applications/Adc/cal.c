@@ -0,0 +1,298 @@
+/*
+cal changes the ADC calibration record and saves it in EEPROM
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+The record (see references.h) is loaded at power-up, a change is used right away 
+and kept after a reset once it is saved.
+*/
+
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include "../lib/parse.h"
+#include "../lib/adc_bsd.h"
+#include "../lib/references.h"
+#include "../lib/json_bsd.h"
+#include "cal.h"
+
+typedef enum CAL_DO_enum
+{
+    CAL_DO_REF,
+    CAL_DO_GAIN,
+    CAL_DO_OFFSET,
+    CAL_DO_SEL,
+    CAL_DO_MUX,
+    CAL_DO_SAMP,
+    CAL_DO_SAVE,
+    CAL_DO_LOAD,
+    CAL_DO_DEFAULT
+} CAL_DO_t;
+
+// token index is the CAL_DO_t
+static const char cal_tokens[] PROGMEM = "ref\0gain\0offset\0sel\0mux\0samp\0save\0load\0default\0";
+
+// /cal ref|gain|offset|sel|mux|samp|save|load|default[,refs|channels,value[,value]]
+// the ranges are checked for each thing that is set
+static const struct Arg_Schema cal_schema[] PROGMEM = {
+    {ARG_TYPE_TOKEN, 0, 0, cal_tokens},
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_INT32, -ADC_OFFSET_MAX, ADC_REF_UV_MAX, NULL},
+    {ARG_TYPE_INT32, 0, 0x7F, NULL}
+};
+
+// values each setting takes, and the arguments it has
+static const int32_t cal_min[] PROGMEM = {100000L, 0, -ADC_OFFSET_MAX, 0, 0, 0};
+static const int32_t cal_max[] PROGMEM = {ADC_REF_UV_MAX, 0xFFFF, ADC_OFFSET_MAX, ADC_REFS-1, 0x7F, 0xFF};
+static const uint8_t cal_args[] PROGMEM = {3, 3, 3, 3, 4, 3, 1, 1, 1};
+
+// channel settings in the list
+#define CAL_FIELDS 6
+static const char key_gain[] PROGMEM = "gain";
+static const char key_offset[] PROGMEM = "offset";
+static const char key_sel[] PROGMEM = "sel";
+static const char key_pos[] PROGMEM = "pos";
+static const char key_neg[] PROGMEM = "neg";
+static const char key_samp[] PROGMEM = "samp";
+static PGM_P const cal_keys[CAL_FIELDS] PROGMEM = {key_gain, key_offset, key_sel, key_pos, key_neg, key_samp};
+
+static int32_t cal_field(uint8_t field, uint8_t ch)
+{
+    struct Adc_Cal_Ch *cal = &adc_cal.ch[ch];
+    switch (field)
+    {
+        case 0:
+            return cal->gain;
+        case 1:
+            return cal->offset;
+        case 2:
+            return cal->ref;
+        case 3:
+            return cal->muxpos;
+        case 4:
+            return cal->muxneg;
+        default:
+            return cal->sampctrl;
+    }
+}
+
+// After a change is applied the running /rate (if any) is checked again, when it can not be made the record 
+// is put back as it was and RateNotMade is the reply. Returns 0 when it was put back.
+static uint8_t cal_retime(const struct Adc_Cal_Record *old, uint8_t old_source)
+{
+    if ( adc_event_retime() ) return 1;
+    adc_cal = *old;
+    adc_cal_source = old_source;
+    adc_cal_apply();
+    if ( !adc_event_retime() ) disable_ADC_event_conversion(); // it was running with the old record
+    printf_P(PSTR("{\"err\":\"RateNotMade\"}\r\n"));
+    initCommandBuffer();
+    return 0;
+}
+
+/* /0/cal? gives the record, e.g., 
+   {"cal":"eeprom|default|changed","ref":["5000000","1024000","2048000","4096000"],"gain":["32768",..],"offset":["0",..],"sel":["0",..],"pos":["0",..],"neg":["64",..],"samp":["0",..]}
+   /0/cal ref,0..3,microvolts sets a measured reference (0 is VDD, 1 is 1V024, 2 is 2V048, 3 is 4V096)
+   /0/cal gain,all|0..7|a-b|0xHH,0..65535 is a Q1.15 gain (32768 is 1.0)
+   /0/cal offset,channels,-2047..2047 is added to a 12 bit reading before the gain
+   /0/cal sel,channels,0..3 is the reference of the channel
+   /0/cal mux,channels,muxpos,muxneg are the ADC0.MUXPOS and ADC0.MUXNEG settings
+   /0/cal samp,channels,0..255 is the ADC0.SAMPCTRL setting (sample time in ADC clocks)
+   /0/cal save|load|default */
+void Calibration(void)
+{
+    if ( (command_done == 10) )
+    {
+        if (arg_count)
+        {
+            if ( !typeArguments(cal_schema, 4) )
+            {
+                printf_P(PSTR("{\"err\":\"CalArg%dOutOfRng\"}\r\n"), arg_err_index);
+                initCommandBuffer();
+                return;
+            }
+            uint8_t todo = arg_val[0].token;
+            struct Adc_Cal_Record old = adc_cal;
+            uint8_t old_source = adc_cal_source;
+            if (arg_count != pgm_read_byte(&cal_args[todo]))
+            {
+                printf_P(PSTR("{\"err\":\"CalArgCount\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
+            if (todo <= CAL_DO_SAMP)
+            {
+                int32_t value = arg_val[2].i32;
+                uint8_t refs_bad = ( (todo == CAL_DO_REF) && (arg_val[1].set >= (1UL << ADC_REFS)) );
+                if ( refs_bad || (value < (int32_t) pgm_read_dword(&cal_min[todo])) || (value > (int32_t) pgm_read_dword(&cal_max[todo])) )
+                {
+                    printf_P(PSTR("{\"err\":\"CalValueOutOfRng\"}\r\n"));
+                    initCommandBuffer();
+                    return;
+                }
+                for (uint8_t i = 0; i < ADC_CHANNELS; i++)
+                {
+                    if ( !(arg_val[1].set & (1<<i)) ) continue;
+                    struct Adc_Cal_Ch *cal = &adc_cal.ch[i];
+                    switch (todo)
+                    {
+                        case CAL_DO_REF:
+                            adc_cal.ref_uv[i] = (uint32_t) value;
+                            break;
+                        case CAL_DO_GAIN:
+                            cal->gain = (uint16_t) value;
+                            break;
+                        case CAL_DO_OFFSET:
+                            cal->offset = (int16_t) value;
+                            break;
+                        case CAL_DO_SEL:
+                            cal->ref = (uint8_t) value;
+                            break;
+                        case CAL_DO_MUX:
+                            cal->muxpos = (uint8_t) value;
+                            cal->muxneg = (uint8_t) arg_val[3].i32;
+                            break;
+                        default:
+                            cal->sampctrl = (uint8_t) value;
+                            break;
+                    }
+                }
+                adc_cal_source = ADC_CAL_CHANGED; // the record in use is not the saved one
+            }
+            else if (todo == CAL_DO_SAVE)
+            {
+                adc_cal_save();
+            }
+            else if (todo == CAL_DO_LOAD)
+            {
+                if ( !adc_cal_load() ) adc_cal_defaults();
+            }
+            else
+            {
+                adc_cal_defaults();
+            }
+            adc_cal_apply();
+            if ( !cal_retime(&old, old_source) ) return; // the sample time can be too long for the rate
+        }
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 11;
+    }
+    else if ( (command_done == 11) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("cal"));
+        if (adc_cal_source == ADC_CAL_EEPROM)
+        {
+            json_str_P(PSTR("eeprom"));
+        }
+        else if (adc_cal_source == ADC_CAL_CHANGED)
+        {
+            json_str_P(PSTR("changed"));
+        }
+        else
+        {
+            json_str_P(PSTR("default"));
+        }
+        json_key_P(PSTR("ref"));
+        json_arr_begin();
+        for (uint8_t r = 0; r < ADC_REFS; r++)
+        {
+            json_uint(adc_cal.ref_uv[r]);
+        }
+        json_arr_end();
+        for (uint8_t field = 0; field < CAL_FIELDS; field++)
+        {
+            json_key_P( (PGM_P) pgm_read_word(&cal_keys[field]) );
+            json_arr_begin();
+            for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+            {
+                json_int(cal_field(field, ch));
+            }
+            json_arr_end();
+        }
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+// /in channels,ain0..ain7|d01|d23|d45|d67|temp|dac0|dacref0..2|gnd
+static const struct Arg_Schema in_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_TOKEN, 0, 0, adc_input_tokens}
+};
+
+/* /0/in? gives the input and unit of each channel, e.g., 
+   {"in":["d01","ain2","ain2","ain3","ain4","ain5","ain6","temp"],"unit":["Vd","V","V","V","V","V","V","C"]}
+   an input set with /cal mux that is not a named one shows as "mux".
+   /0/in 0,d01 selects AIN0 - AIN1 (differential) for channel 0, it changes the record as /cal does */
+void Input(void)
+{
+    if ( (command_done == 10) )
+    {
+        if (arg_count)
+        {
+            if ( !typeArguments(in_schema, 2) )
+            {
+                printf_P(PSTR("{\"err\":\"InArg%dOutOfRng\"}\r\n"), arg_err_index);
+                initCommandBuffer();
+                return;
+            }
+            struct Adc_Cal_Record old = adc_cal;
+            uint8_t old_source = adc_cal_source;
+            for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+            {
+                if (arg_val[0].set & (1<<ch)) adc_cal_input( (ADC_CH_t) ch, (ADC_INPUT_t) arg_val[1].token);
+            }
+            adc_cal_apply();
+            if ( !cal_retime(&old, old_source) ) return; // the sample time can be too long for the rate
+        }
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 11;
+    }
+    else if ( (command_done == 11) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("in"));
+        json_arr_begin();
+        for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+        {
+            ADC_INPUT_t in = adc_cal_input_of( (ADC_CH_t) ch);
+            json_str_P( (in < ADC_INPUTS) ? token_word(adc_input_tokens, in) : PSTR("mux") );
+        }
+        json_arr_end();
+        json_key_P(PSTR("unit"));
+        json_arr_begin();
+        for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+        {
+            json_str_P(token_word(adc_unit_tokens, adcConfMap[ch].unit));
+        }
+        json_arr_end();
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
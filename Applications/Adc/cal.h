@@ -0,0 +1,7 @@
+#ifndef Cal_H
+#define Cal_H
+
+extern void Calibration(void);
+extern void Input(void);
+
+#endif // Cal_H
@@ -0,0 +1,370 @@
+/*
+capture takes ADC frames into a RAM ring and dumps them in binary
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+A dump is a header line, the frames oldest first as raw bytes, and a footer line with the 
+CRC16 (poly 0xA001, init 0xFFFF) of the raw bytes. The bytes go out as the transmit buffer 
+has room, so the main loop keeps running while they drain. capture2csv.py decodes a dump.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include "../lib/parse.h"
+#include "../lib/json_bsd.h"
+#include "../lib/adc_bsd.h"
+#include "../lib/references.h"
+#include "../lib/timers_bsd.h"
+#include "../lib/uart0_bsd.h"
+#include "capture.h"
+
+static const char cap_tokens[] PROGMEM = "start\0stop\0dump\0";
+
+// token index is the ADC_TRIG_MODE_t
+static const char trig_tokens[] PROGMEM = "above\0below\0rise\0fall\0inside\0outside\0";
+
+// names of ADC_TRIG_STATE_t for the status
+static const char trig_state_names[] PROGMEM = "off\0pre\0armed\0post\0done\0";
+
+// /cap start|stop|dump[,channels[,frames]]
+static const struct Arg_Schema cap_schema[] PROGMEM = {
+    {ARG_TYPE_TOKEN, 0, 0, cap_tokens},
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_UINT32, 0, 65535, NULL}
+};
+
+// /trig above|below|rise|fall|inside|outside,channel,level[,level]
+static const struct Arg_Schema trig_schema[] PROGMEM = {
+    {ARG_TYPE_TOKEN, 0, 0, trig_tokens},
+    {ARG_TYPE_UINT32, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_UINT32, 0, 65535, NULL}, // oversampled channels can be up to 16 bits
+    {ARG_TYPE_UINT32, 0, 65535, NULL}
+};
+
+// /arm channels,pre,post
+static const struct Arg_Schema arm_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_UINT32, 0, 65535, NULL},
+    {ARG_TYPE_UINT32, 0, 65535, NULL}
+};
+
+// progress of a dump
+static uint16_t dump_frame; // frame in the ring being sent
+static uint16_t dump_left; // frames to send
+static uint8_t dump_byte; // next byte of the frame
+static uint16_t dump_crc;
+static uint8_t dump_diff; // differential channels in the dump
+static uint8_t dump_pre; // the trigger frame is frame pre
+
+// what a status reply gives, taken when it starts so each json pass sends the same thing
+static uint16_t status_count;
+static uint16_t status_left;
+static uint8_t status_state;
+static struct Adc_Trig status_trig;
+
+/* /0/cap start,all|0..7|a-b|0xHH[,0..frames] takes a frame each time the channels are scanned, 
+   it stops after frames or (when zero or not given) keeps the newest frames until stopped.
+   /0/cap stop
+   /0/cap dump stops the capture and sends what is in the ring. */
+void Capture(void)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !typeArguments(cap_schema, 3) )
+        {
+            printf_P(PSTR("{\"err\":\"CapArg%dOutOfRng\"}\r\n"), arg_err_index);
+            initCommandBuffer();
+            return;
+        }
+        uint8_t todo = arg_val[0].token;
+        if (todo == 0)
+        {
+            if ( (arg_count < 2) || !adc_capture_start( (uint8_t) arg_val[1].set, (arg_count == 3) ? (uint16_t) arg_val[2].u32 : 0) )
+            {
+                printf_P(PSTR("{\"err\":\"CapFramesOutOfRng\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
+            command_done = 20; // status
+        }
+        else if (todo == 1)
+        {
+            adc_capture_stop();
+            command_done = 20;
+        }
+        else
+        {
+            // the ring is frozen while it is sent, a frame could otherwise change under the dump
+            adc_capture_stop();
+            dump_frame = adc_capture_oldest();
+            dump_left = adc_capture_count;
+            dump_byte = 0;
+            dump_crc = 0xFFFF;
+            dump_pre = (adc_trig_state == ADC_TRIG_DONE);
+            dump_diff = 0;
+            for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+            { // readings of differential channels are signed (two's complement in 12 bits)
+                if ( (adc_capture_channels & (1<<ch)) && adcConfMap[ch].convmode ) dump_diff |= (1<<ch);
+            }
+            json_start(JSON_QUOTE_NUMBERS);
+            command_done = 11;
+        }
+    }
+    else if ( (command_done == 11) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("cap"));
+        json_str_P(PSTR("dump"));
+        json_key_P(PSTR("m"));
+        json_uint(adc_capture_channels);
+        json_key_P(PSTR("n"));
+        json_uint(dump_left);
+        json_key_P(PSTR("fb"));
+        json_uint(adc_capture_frame_size);
+        json_key_P(PSTR("clk"));
+        json_uint(TICK_FINE_CLOCKS);
+        json_key_P(PSTR("fcpu"));
+        json_uint(F_CPU);
+        if (dump_pre)
+        { // frame number pre is the trigger frame
+            json_key_P(PSTR("pre"));
+            json_uint(adc_trig.pre);
+        }
+        if (dump_diff)
+        {
+            json_key_P(PSTR("d"));
+            json_uint(dump_diff);
+        }
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        command_done = 12;
+    }
+    else if ( (command_done == 12) )
+    {
+        // fill the transmit buffer, the rest goes after it drains
+        uint8_t room = uart0_availableForWriteBytes();
+        while (room && dump_left)
+        {
+            uint8_t data = adc_capture[dump_frame * adc_capture_frame_size + dump_byte];
+            putchar(data);
+            dump_crc = _crc16_update(dump_crc, data);
+            room--;
+            if (++dump_byte >= adc_capture_frame_size)
+            {
+                dump_byte = 0;
+                dump_left--;
+                if (++dump_frame >= adc_capture_frames) dump_frame = 0;
+            }
+        }
+        if (!dump_left) command_done = 13;
+    }
+    else if ( (command_done == 13) )
+    {
+        // end the raw bytes so the footer starts a line
+        if (uart0_availableForWriteBytes() < 2) return;
+        putchar('\r');
+        putchar('\n');
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 14;
+    }
+    else if ( (command_done == 14) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("crc"));
+        json_uint(dump_crc);
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return;
+        initCommandBuffer();
+    }
+    else if ( (command_done == 20) || (command_done == 21) )
+    {
+        CaptureStatus();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+/* /0/cap? gives {"cap":"run","m":"15","n":"120","max":"819","left":"0"} */
+void CaptureStatus(void)
+{
+    if ( (command_done == 10) || (command_done == 20) )
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            status_count = adc_capture_count;
+            status_left = adc_capture_left;
+        }
+        status_state = (adc_capture_mask != 0);
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 21;
+    }
+    else if ( (command_done == 21) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("cap"));
+        json_str_P(status_state ? PSTR("run") : PSTR("stop"));
+        json_key_P(PSTR("m"));
+        json_uint(adc_capture_channels);
+        json_key_P(PSTR("n"));
+        json_uint(status_count);
+        json_key_P(PSTR("max"));
+        json_uint(adc_capture_frames);
+        json_key_P(PSTR("left"));
+        json_uint(status_left);
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+/* /0/trig rise,0,2048 sets the trigger, a window mode has two levels, e.g., /0/trig outside,2,1000,3000 */
+void Trigger(void)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !typeArguments(trig_schema, 4) )
+        {
+            printf_P(PSTR("{\"err\":\"TrigArg%dOutOfRng\"}\r\n"), arg_err_index);
+            initCommandBuffer();
+            return;
+        }
+        uint8_t mode = arg_val[0].token;
+        uint8_t window = (mode >= ADC_TRIG_INSIDE);
+        if ( (window && (arg_count != 4)) || (!window && (arg_count != 3)) )
+        {
+            printf_P(PSTR("{\"err\":\"TrigLevelCount\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        if ( window && (arg_val[3].u32 < arg_val[2].u32) )
+        {
+            printf_P(PSTR("{\"err\":\"TrigWindowLoHi\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        // the ISR checks these each frame
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            adc_trig.mode = mode;
+            adc_trig.ch = (uint8_t) arg_val[1].u32;
+            adc_trig.lo = (int32_t) arg_val[2].u32;
+            adc_trig.hi = window ? (int32_t) arg_val[3].u32 : 0;
+        }
+        command_done = 11;
+    }
+    else if ( (command_done == 11) || (command_done == 12) )
+    {
+        TriggerStatus();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+/* /0/arm all|0..7|a-b|0xHH,pre,post captures the channels until the trigger, then post more frames, 
+   the ring is frozen with pre frames before the trigger frame. */
+void Arm(void)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !typeArguments(arm_schema, 3) )
+        {
+            printf_P(PSTR("{\"err\":\"ArmArg%dOutOfRng\"}\r\n"), arg_err_index);
+            initCommandBuffer();
+            return;
+        }
+        if ( !adc_capture_trigger( (uint8_t) arg_val[0].set, (uint16_t) arg_val[1].u32, (uint16_t) arg_val[2].u32) )
+        {
+            printf_P(PSTR("{\"err\":\"ArmFramesOutOfRng\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        command_done = 11;
+    }
+    else if ( (command_done == 11) || (command_done == 12) )
+    {
+        TriggerStatus();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+/* /0/trig? gives {"trig":"armed","mode":"rise","ch":"0","lo":"2048","hi":"0","pre":"100","post":"400","n":"37"} 
+   when done "t" is the ticksFine() time stamp of the trigger frame */
+void TriggerStatus(void)
+{
+    if ( (command_done == 10) || (command_done == 11) )
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            status_state = adc_trig_state;
+            status_trig = adc_trig;
+            status_count = adc_capture_count;
+        }
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 12;
+    }
+    else if ( (command_done == 12) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("trig"));
+        json_str_P(token_word(trig_state_names, status_state));
+        json_key_P(PSTR("mode"));
+        json_str_P(token_word(trig_tokens, status_trig.mode));
+        json_key_P(PSTR("ch"));
+        json_uint(status_trig.ch);
+        json_key_P(PSTR("lo"));
+        json_int(status_trig.lo);
+        json_key_P(PSTR("hi"));
+        json_int(status_trig.hi);
+        json_key_P(PSTR("pre"));
+        json_uint(status_trig.pre);
+        json_key_P(PSTR("post"));
+        json_uint(status_trig.post);
+        json_key_P(PSTR("n"));
+        json_uint(status_count);
+        if (status_state == ADC_TRIG_DONE)
+        {
+            json_key_P(PSTR("t"));
+            json_uint(status_trig.stamp);
+        }
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
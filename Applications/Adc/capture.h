@@ -0,0 +1,10 @@
+#ifndef Capture_H
+#define Capture_H
+
+extern void Capture(void);
+extern void CaptureStatus(void);
+extern void Trigger(void);
+extern void Arm(void);
+extern void TriggerStatus(void);
+
+#endif // Capture_H
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# Decode a /0/cap dump from the Adc application into CSV.
+# Make sure the top line ends with a LF only and set the file as an executable with chmod +x <this_file>
+#
+# From a file that has the dump (the command echo before the header is skipped):
+# $ ./capture2csv.py dump.bin > capture.csv
+# or ask the node for it (needs pyserial, pip3 install pyserial):
+# $ ./capture2csv.py /dev/ttyUSB0 0 > capture.csv
+#
+# A dump is a header line, e.g., {"cap":"dump","m":"15","n":"120","fb":"10","clk":"64","fcpu":"16000000"}
+# then n frames of fb bytes, then \r\n{"crc":"N"}\r\n where N is the CRC16 (poly 0xA001, init 0xFFFF) of the frames.
+# A dump of a trigger (/0/arm) capture has "pre", the frame number of the trigger frame.
+# A dump with differential channels (see /0/in) has "d", the mask of those channels, their readings are signed.
+# A frame is a time stamp (four bytes little endian, in units of clk CPU clocks) and the 12 bit readings of
+# the channels in the mask "m", two readings are packed in three bytes.
+
+import sys, json, os
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if (crc & 1) else (crc >> 1)
+    return crc
+
+def read_dump(stream_read, stream_readline):
+    # header is the first line that starts with {"cap":"dump"
+    while True:
+        line = stream_readline()
+        if not line:
+            sys.exit("no dump header found")
+        line = line.strip()
+        if line.startswith(b'{"cap":"dump"'):
+            break
+        if line.startswith(b'{"err"'):
+            sys.exit(line.decode('ascii'))
+    header = json.loads(line.decode('ascii'))
+    size = int(header['n']) * int(header['fb'])
+    frames = stream_read(size)
+    if len(frames) != size:
+        sys.exit("dump is short %d of %d bytes" % (len(frames), size))
+    footer = b''
+    while not footer.strip():
+        footer = stream_readline()
+        if not footer:
+            sys.exit("no crc footer found")
+    crc = int(json.loads(footer.strip().decode('ascii'))['crc'])
+    if crc != crc16(frames):
+        sys.exit("crc %d does not match %d" % (crc16(frames), crc))
+    return header, frames
+
+def frames_to_csv(header, frames, out):
+    mask = int(header['m'])
+    diff = int(header.get('d', 0))
+    fb = int(header['fb'])
+    seconds_per_count = float(header['clk']) / float(header['fcpu'])
+    channels = [ch for ch in range(8) if mask & (1 << ch)]
+    out.write('time,' + ','.join('ADC%d' % ch for ch in channels) + '\n')
+    # time is from the first frame, or from the trigger frame (number pre) of an /0/arm capture
+    start_frame = int(header.get('pre', 0))
+    start = int.from_bytes(frames[start_frame*fb:start_frame*fb+4], 'little')
+    for at in range(0, len(frames), fb):
+        frame = frames[at:at+fb]
+        stamp = int.from_bytes(frame[0:4], 'little')
+        values = []
+        packed = frame[4:]
+        for i in range(len(channels)):
+            j = (i // 2) * 3
+            if i & 1:
+                values.append((packed[j+1] >> 4) | (packed[j+2] << 4))
+            else:
+                values.append(packed[j] | ((packed[j+1] & 0x0F) << 8))
+            if (diff & (1 << channels[i])) and (values[i] & 0x800):
+                values[i] -= 0x1000 # a negative differential reading
+        counts = (stamp - start) & 0xFFFFFFFF # the stamp wraps at 32 bits
+        if counts & 0x80000000:
+            counts -= 0x100000000 # before the trigger
+        elapsed = counts * seconds_per_count
+        out.write('%.6f,' % elapsed + ','.join(str(v) for v in values) + '\n')
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        sys.exit("usage: capture2csv.py dump_file | serial_port [address]")
+    if os.path.exists(sys.argv[1]) and sys.argv[1].startswith('/dev/'):
+        import serial
+        address = sys.argv[2] if len(sys.argv) > 2 else '0'
+        ser = serial.Serial(sys.argv[1], 38400, timeout=3)
+        ser.reset_input_buffer()
+        ser.write(('/' + address + '/cap dump\n').encode('ascii'))
+        header, frames = read_dump(ser.read, ser.readline)
+        ser.close()
+    else:
+        with open(sys.argv[1], 'rb') as f:
+            header, frames = read_dump(f.read, f.readline)
+    frames_to_csv(header, frames, sys.stdout)
@@ -27,7 +27,14 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 #include "../lib/rpu_mgr.h"
 #include "../lib/io_enum_bsd.h"
 #include "../Uart/id.h"
+#include "../Uart/mode.h"
+#include "../Uart/script.h"
 #include "analog.h"
+#include "sub.h"
+#include "capture.h"
+#include "alarm.h"
+#include "cal.h"
+#include "stat.h"
 
 #define ADC_DELAY_MILSEC 200UL
 static unsigned long adc_started_at;
@@ -39,10 +46,35 @@ static char rpu_addr;
 
 void ProcessCmd()
 { 
+    if ( ScriptCapture() ) return; // the line after /script add is saved rather than run
     if ( (strcmp_P( command, PSTR("/id?")) == 0) && ( (arg_count == 0) || (arg_count == 1)) )
     {
         Id("Adc");
     }
+    if ( (strcmp_P( command, PSTR("/pipe?")) == 0) && (arg_count == 0) )
+    {
+        Pipe();
+    }
+    if ( (strcmp_P( command, PSTR("/pipe")) == 0) && (arg_count == 1) )
+    {
+        Pipe();
+    }
+    if ( (strcmp_P( command, PSTR("/echo?")) == 0) && (arg_count == 0) )
+    {
+        Echo();
+    }
+    if ( (strcmp_P( command, PSTR("/echo")) == 0) && (arg_count == 1) )
+    {
+        Echo();
+    }
+    if ( (strcmp_P( command, PSTR("/script?")) == 0) && (arg_count == 0) )
+    {
+        ScriptList();
+    }
+    if ( (strcmp_P( command, PSTR("/script")) == 0) && ( (arg_count == 1) || (arg_count == 2) ) )
+    {
+        Script();
+    }
     if ( (strcmp_P( command, PSTR("/analog?")) == 0) && ( (arg_count >= 1 ) && (arg_count <= 5) ) )
     {
         Analogf(cnvrt_milli(2000UL)); // update every 2 sec until terminated
@@ -51,6 +83,110 @@ void ProcessCmd()
     {
         Analogd(cnvrt_milli(2000UL)); // update every 2 sec until terminated
     }
+    if ( (strcmp_P( command, PSTR("/adcf?")) == 0) && ( (arg_count >= 1 ) && (arg_count <= 5) ) )
+    {
+        Analogc(cnvrt_milli(2000UL)); // update every 2 sec until terminated
+    }
+    if ( (strcmp_P( command, PSTR("/filt?")) == 0) && (arg_count == 0) )
+    {
+        Filter();
+    }
+    if ( (strcmp_P( command, PSTR("/filt")) == 0) && ( (arg_count == 2) || (arg_count == 3) ) )
+    {
+        Filter();
+    }
+    if ( (strcmp_P( command, PSTR("/acc?")) == 0) && (arg_count == 0) )
+    {
+        Accumulation();
+    }
+    if ( (strcmp_P( command, PSTR("/acc")) == 0) && (arg_count == 3) )
+    {
+        Accumulation();
+    }
+    if ( (strcmp_P( command, PSTR("/cal?")) == 0) && (arg_count == 0) )
+    {
+        Calibration();
+    }
+    if ( (strcmp_P( command, PSTR("/cal")) == 0) && ( (arg_count >= 1) && (arg_count <= 4) ) )
+    {
+        Calibration();
+    }
+    if ( (strcmp_P( command, PSTR("/in?")) == 0) && (arg_count == 0) )
+    {
+        Input();
+    }
+    if ( (strcmp_P( command, PSTR("/in")) == 0) && (arg_count == 2) )
+    {
+        Input();
+    }
+    if ( (strcmp_P( command, PSTR("/stat?")) == 0) && (arg_count == 0) )
+    {
+        StatisticsList();
+    }
+    if ( (strcmp_P( command, PSTR("/stat")) == 0) && (arg_count == 2) )
+    {
+        Statistics();
+    }
+    if ( (strcmp_P( command, PSTR("/scan?")) == 0) && (arg_count == 0) )
+    {
+        Scan();
+    }
+    if ( (strcmp_P( command, PSTR("/scan")) == 0) && (arg_count == 2) )
+    {
+        Scan();
+    }
+    if ( (strcmp_P( command, PSTR("/rate?")) == 0) && (arg_count == 0) )
+    {
+        Rate();
+    }
+    if ( (strcmp_P( command, PSTR("/rate")) == 0) && (arg_count == 1) )
+    {
+        Rate();
+    }
+    if ( (strcmp_P( command, PSTR("/cap?")) == 0) && (arg_count == 0) )
+    {
+        CaptureStatus();
+    }
+    if ( (strcmp_P( command, PSTR("/cap")) == 0) && ( (arg_count >= 1) && (arg_count <= 3) ) )
+    {
+        Capture();
+    }
+    if ( (strcmp_P( command, PSTR("/trig?")) == 0) && (arg_count == 0) )
+    {
+        TriggerStatus();
+    }
+    if ( (strcmp_P( command, PSTR("/trig")) == 0) && ( (arg_count == 3) || (arg_count == 4) ) )
+    {
+        Trigger();
+    }
+    if ( (strcmp_P( command, PSTR("/arm")) == 0) && (arg_count == 3) )
+    {
+        Arm();
+    }
+    if ( (strcmp_P( command, PSTR("/alarm?")) == 0) && (arg_count == 0) )
+    {
+        AlarmList();
+    }
+    if ( (strcmp_P( command, PSTR("/alarm")) == 0) && ( (arg_count >= 2) && (arg_count <= 4) ) )
+    {
+        Alarm();
+    }
+    if ( (strcmp_P( command, PSTR("/ack")) == 0) && (arg_count == 1) )
+    {
+        Ack();
+    }
+    if ( (strcmp_P( command, PSTR("/sub")) == 0) && ( (arg_count >= 3) && (arg_count <= 5) ) )
+    {
+        Subscribe();
+    }
+    if ( (strcmp_P( command, PSTR("/unsub")) == 0) && (arg_count == 1) )
+    {
+        Unsubscribe();
+    }
+    if ( (strcmp_P( command, PSTR("/sub?")) == 0) && (arg_count == 0) )
+    {
+        Subscriptions();
+    }
 }
 
 void setup(void) 
@@ -95,6 +231,12 @@ void setup(void)
     /* Clear and setup the command buffer, (probably not needed at this point) */
     initCommandBuffer();
 
+    /* Echo and other command line modes are saved in EEPROM */
+    LoadModes();
+
+    /* a script saved in EEPROM can run the setup commands at power-up */
+    ScriptAutorun();
+
     // Enable global interrupts to start TIMER0 and UART ISR's
     sei(); 
     
@@ -126,6 +268,7 @@ void blink(void)
 
 void adc_burst(void)
 {
+    if (adc_event_rate) return; // conversions are started by events (see /rate)
     unsigned long kRuntime= elapsed(&adc_started_at);
     if ((kRuntime) > ((unsigned long)ADC_DELAY_MILSEC))
     {
@@ -143,11 +286,18 @@ int main(void)
         // use LED to show if I2C has a bus manager
         blink();
         
+        // a running script puts its next line in the command queue while the command line is idle
+        if ( is_command_idle() )
+        {
+            ScriptFeed(rpu_addr);
+        }
+
         // check if character is available to assemble a command, e.g. non-blocking
-        if ( (!command_done) && uart0_available() ) // command_done is an extern from parse.h
+        // input waits while a subscription frame or alarm is going out, so an echo does not land in it
+        if ( (!command_done) && (!sub_pushing()) && (!alarm_pushing()) && (CommandQueued() || uart0_available()) ) // command_done is an extern from parse.h
         {
-            // get a character from stdin and use it to assemble a command
-            AssembleCommand(getchar());
+            // get a character (pipelined input first, then stdin) and use it to assemble a command
+            AssembleCommand( CommandQueued() ? DequeueCommandInput() : getchar() );
 
             // address is an ascii value, warning: a null address would terminate the command string. 
             StartEchoWhenAddressed(rpu_addr);
@@ -158,13 +308,27 @@ int main(void)
         // the first byte is used as a warning, it is the onlly chance to detect a possible collision.
         if ( command_done && uart0_available() )
         {
-            // dump the transmit buffer to limit a collision 
-            uart0_empty(); 
-            initCommandBuffer();
+            if (command_pipeline)
+            { // the host is sending the next command line, hold it until this command is done
+                QueueCommandInput(getchar());
+            }
+            else
+            {
+                // dump the transmit buffer to limit a collision 
+                uart0_empty(); 
+                initCommandBuffer();
+            }
         }
         
         // delay between ADC burst
         adc_burst();
+
+        // push alarms and subscription frames while the command line is idle, one at a time
+        if ( is_command_idle() )
+        {
+            if ( !sub_pushing() ) AlarmPush();
+            if ( !alarm_pushing() ) SubPush();
+        }
           
         // finish echo of the command line befor starting a reply (or the next part of a reply)
         if ( command_done && uart0_availableForWrite() )
@@ -0,0 +1,169 @@
+/*
+stat keeps the count, min, max, mean and variance of the readings of ADC channels on the node
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+The ISR adds each reading to integer sums (see adc_bsd.h), the mean and variance are 
+worked out from them when the reply goes out, so a summary of thousands of readings 
+is one line instead of streaming them to the host.
+*/
+
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include "../lib/parse.h"
+#include "../lib/adc_bsd.h"
+#include "../lib/timers_bsd.h"
+#include "../lib/json_bsd.h"
+#include "stat.h"
+
+// /stat channels,0|10..60000
+static const struct Arg_Schema stat_schema[] PROGMEM = {
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_UINT32, 0, STAT_WINDOW_MAX, NULL}
+};
+
+// fields of the list, each is an array over the channels
+#define STAT_FIELDS 5
+static const char key_n[] PROGMEM = "n";
+static const char key_min[] PROGMEM = "min";
+static const char key_max[] PROGMEM = "max";
+static const char key_mean[] PROGMEM = "mean";
+static const char key_var[] PROGMEM = "var";
+static PGM_P const stat_keys[STAT_FIELDS] PROGMEM = {key_n, key_min, key_max, key_mean, key_var};
+
+static struct Adc_Stats stat_set; // the set a reply is made from, taken once so each pass has the same items
+static uint8_t stat_listed; // channels in the reply
+
+// a / b rounded half away from zero
+static int64_t div_round(int64_t a, uint32_t b)
+{
+    return (a < 0) ? -((-a + (b >> 1)) / b) : ((a + (b >> 1)) / b);
+}
+
+// mean of the readings in thousandths of a count
+static int32_t stat_mean_milli(struct Adc_Stat *st)
+{
+    if (!st->n) return 0;
+    return st->first * 1000L + (int32_t) div_round( (int64_t) st->sum * 1000, st->n);
+}
+
+// population variance in thousandths of a count squared, n*sumsq - sum^2 is exact in 64 bits
+static uint64_t stat_var_milli(struct Adc_Stat *st)
+{
+    if (!st->n) return 0;
+    uint64_t m2 = st->sumsq * st->n - (uint64_t) ( (int64_t) st->sum * st->sum);
+    uint64_t per_n = m2 / st->n;
+    if (per_n < 0x4000000000000ULL) return (per_n * 1000) / st->n; // keeps the digits when it can
+    return (per_n / st->n) * 1000;
+}
+
+/* /0/stat all|0..7|a-b|0xHH,0|10..60000 starts statistics of the channels over a window of milliseconds, 
+   or since the last /0/stat? when it is zero, e.g., /0/stat 0-3,1000. A mask of 0x00 stops them. */
+void Statistics(void)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !typeArguments(stat_schema, 2) )
+        {
+            printf_P(PSTR("{\"err\":\"StatArg%dOutOfRng\"}\r\n"), arg_err_index);
+            initCommandBuffer();
+            return;
+        }
+        uint16_t window_ms = (uint16_t) arg_val[1].u32;
+        if ( window_ms && (window_ms < STAT_WINDOW_MIN) )
+        {
+            printf_P(PSTR("{\"err\":\"StatWindowOutOfRng\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        adc_stat_start( (uint8_t) arg_val[0].set, window_ms);
+        printf_P(PSTR("{\"stat\":\"%u\",\"ms\":\"%u\"}\r\n"), adc_stat_mask, window_ms);
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+/* /0/stat? gives the statistics of the finished window, or of the readings since the last /0/stat? (which starts a new set)
+   {"ms":"1000","m":"15","n":["625","625","625","625"],"min":[..],"max":[..],"mean":["2047.318",..],"var":["0.412",..]} */
+void StatisticsList(void)
+{
+    if ( (command_done == 10) )
+    {
+        adc_stat_take(&stat_set);
+        stat_listed = adc_stat_mask;
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 11;
+    }
+    else if ( (command_done == 11) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("ms"));
+        uint64_t fine = (unsigned long) (stat_set.end - stat_set.start);
+        json_uint( (uint32_t) ( (fine * TICK_FINE_CLOCKS) / (F_CPU / 1000UL) ) );
+        json_key_P(PSTR("m"));
+        json_uint(stat_listed);
+        for (uint8_t field = 0; field < STAT_FIELDS; field++)
+        {
+            json_key_P( (PGM_P) pgm_read_word(&stat_keys[field]) );
+            json_arr_begin();
+            for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+            {
+                if ( !(stat_listed & (1<<ch)) ) continue;
+                struct Adc_Stat *st = &stat_set.ch[ch];
+                if (field == 0)
+                {
+                    json_uint(st->n);
+                }
+                else if (field == 1)
+                {
+                    json_int(st->min);
+                }
+                else if (field == 2)
+                {
+                    json_int(st->max);
+                }
+                else if (field == 3)
+                {
+                    json_fixed(json_pending() ? stat_mean_milli(st) : 0, 3, 3);
+                }
+                else
+                { // a variance that does not fit with three decimals is given in whole counts squared
+                    uint64_t var_milli = json_pending() ? stat_var_milli(st) : 0;
+                    if (var_milli <= 0x7FFFFFFFUL)
+                    {
+                        json_fixed( (int32_t) var_milli, 3, 3);
+                    }
+                    else
+                    {
+                        json_uint( (uint32_t) ( (var_milli + 500) / 1000) );
+                    }
+                }
+            }
+            json_arr_end();
+        }
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef Stat_H
+#define Stat_H
+
+// window of the statistics in milliseconds, zero is since the last read
+#define STAT_WINDOW_MIN 10
+#define STAT_WINDOW_MAX 60000
+
+extern void Statistics(void);
+extern void StatisticsList(void);
+
+#endif // Stat_H
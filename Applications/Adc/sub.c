@@ -0,0 +1,374 @@
+/*
+sub is a library that pushes analog and digital readings for host subscriptions
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+Note the library files are LGPL, e.g., you need to publish changes of them but can derive from this
+source and copyright or distribute as you see fit (it is Zero Clause BSD).
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+Each subscription has a slot with its kind, channels, period and a sequence number.
+When the command line is idle the main loop calls SubPush(), which samples the next
+subscription that is due and sends its frame in passes (like a command reply). Input
+is not assembled while a frame is going out so a command echo can not land in it.
+*/
+
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <string.h>
+#include "../lib/parse.h"
+#include "../lib/adc_bsd.h"
+#include "../lib/timers_bsd.h"
+#include "../lib/io_enum_bsd.h"
+#include "../lib/json_bsd.h"
+#include "sub.h"
+
+struct Sub_Slot {
+    uint8_t kind; // SUB_KIND_t
+    uint8_t mask; // bit n is ADCn (or AINn for din)
+    uint16_t period_ms; // as it was given
+    unsigned long period; // ticks between samples
+    unsigned long last; // tick of the last sample
+    uint16_t seq; // frames sent
+    uint8_t levels; // din levels that were sent last
+    uint16_t deadband; // adc delta mode when not zero, a channel is sent when it moved more than this
+    uint8_t keyframe; // a full frame is sent after this many periods (so a host can resync)
+    uint8_t since_key; // periods since the last full frame
+    int32_t sent[ADC_CH_ADC7+1]; // adc values the host has (from the last full frame and the deltas after it)
+};
+
+static struct Sub_Slot sub_slot[SUB_SLOTS];
+
+// frame that is going out
+static uint8_t sub_push_id = SUB_SLOTS; // SUB_SLOTS when no frame is going out
+static uint8_t sub_next; // the search for a due subscription starts here so each gets a turn
+static int32_t sub_frame[ADC_CH_ADC7+1];
+static uint8_t sub_frame_count;
+static uint8_t sub_frame_delta; // channels in a delta frame, zero for a full frame
+
+// token index + 1 is the SUB_KIND_t
+static const char sub_kind_tokens[] PROGMEM = "adc\0din\0";
+
+// /sub adc|din,channels,period[,deadband[,keyframe]]
+static const struct Arg_Schema sub_schema[] PROGMEM = {
+    {ARG_TYPE_TOKEN, 0, 0, sub_kind_tokens},
+    {ARG_TYPE_SET, ADC_CH_ADC0, ADC_CH_ADC7, NULL},
+    {ARG_TYPE_UINT32, SUB_MIN_PERIOD_MILSEC, 60000UL, NULL},
+    {ARG_TYPE_UINT32, 1, 65535, NULL}, // oversampled channels can be up to 16 bits
+    {ARG_TYPE_UINT32, 1, 255, NULL}
+};
+
+// /unsub id|all|0-3|0xF
+static const struct Arg_Schema unsub_schema[] PROGMEM = {
+    {ARG_TYPE_SET, 0, (SUB_SLOTS-1), NULL}
+};
+
+static uint8_t sub_id;
+
+// the digital input buffer is only turned on for pins a din subscription uses
+static void din_buffers(void)
+{
+    uint8_t used = 0;
+    for (uint8_t id = 0; id < SUB_SLOTS; id++)
+    {
+        if (sub_slot[id].kind == SUB_KIND_DIN) used |= sub_slot[id].mask;
+    }
+    for (uint8_t pin = MCU_IO_AIN0; pin <= MCU_IO_AIN7; pin++)
+    {
+        PORT_ISC_t isc = (used & (1<<pin)) ? PORT_ISC_INTDISABLE_gc : PORT_ISC_INPUT_DISABLE_gc;
+        ioCntl( (MCU_IO_t) pin, isc, PORT_PULLUP_DISABLE, PORT_INVERT_NORMAL);
+    }
+}
+
+static uint8_t din_levels(uint8_t mask)
+{
+    uint8_t levels = 0;
+    for (uint8_t pin = MCU_IO_AIN0; pin <= MCU_IO_AIN7; pin++)
+    {
+        if ( (mask & (1<<pin)) && ioRead( (MCU_IO_t) pin) ) levels |= (1<<pin);
+    }
+    return levels;
+}
+
+/* /0/sub adc|din,all|0..7-0..7|0xHH,10..60000[ms][,1..65535[,1..255]] */
+void Subscribe(void)
+{
+    if ( (command_done == 10) )
+    {
+        // a period may be given with ms after the number, e.g., 100ms
+        uint8_t len = strlen(arg[2]);
+        if ( (len > 2) && (strcmp_P(&arg[2][len-2], PSTR("ms")) == 0) ) arg[2][len-2] = '\0';
+
+        if ( !typeArguments(sub_schema, 5) )
+        {
+            if (arg_err_index == 0)
+            {
+                printf_P(PSTR("{\"err\":\"SubNaAdcDin\"}\r\n"));
+            }
+            else if (arg_err_index == 1)
+            {
+                printf_P(PSTR("{\"err\":\"SubChOutOfRng\"}\r\n"));
+            }
+            else if (arg_err_index == 2)
+            {
+                printf_P(PSTR("{\"err\":\"SubPeriod10..60000\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"err\":\"SubDeadband|Keyframe\"}\r\n"));
+            }
+            initCommandBuffer();
+            return;
+        }
+        for (sub_id = 0; sub_id < SUB_SLOTS; sub_id++)
+        {
+            if (sub_slot[sub_id].kind == SUB_KIND_NONE) break;
+        }
+        if (sub_id >= SUB_SLOTS)
+        {
+            printf_P(PSTR("{\"err\":\"SubNoSlot\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        struct Sub_Slot *slot = &sub_slot[sub_id];
+        slot->mask = (uint8_t) arg_val[1].set;
+        slot->period_ms = (uint16_t) arg_val[2].u32;
+        slot->period = cnvrt_milli(arg_val[2].u32);
+        slot->last = tickAtomic() - slot->period; // first frame is due now
+        slot->seq = 0;
+        slot->deadband = (arg_count >= 4) ? (uint16_t) arg_val[3].u32 : 0;
+        slot->keyframe = (arg_count >= 5) ? (uint8_t) arg_val[4].u32 : SUB_KEYFRAME_DEFAULT;
+        slot->since_key = 0;
+        slot->kind = arg_val[0].token + 1;
+        if (slot->kind == SUB_KIND_DIN) din_buffers();
+        command_done = 11;
+    }
+    else if ( (command_done == 11) )
+    {
+        printf_P(PSTR("{\"sub\":\"%u\"}\r\n"), sub_id);
+        initCommandBuffer();
+    }
+    else
+    {
+        printf_P(PSTR("{\"err\":\"SubCmdDnWTF\"}\r\n"));
+        initCommandBuffer();
+    }
+}
+
+/* /0/unsub 0..3|all|0..3-0..3|0xH */
+void Unsubscribe(void)
+{
+    if ( (command_done == 10) )
+    {
+        if ( !typeArguments(unsub_schema, 1) )
+        {
+            printf_P(PSTR("{\"err\":\"UnsubIdOutOfRng\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        // other subscriptions are not disturbed
+        for (uint8_t id = 0; id < SUB_SLOTS; id++)
+        {
+            if (arg_val[0].set & (1<<id)) sub_slot[id].kind = SUB_KIND_NONE;
+        }
+        din_buffers();
+        command_done = 11;
+    }
+    else if ( (command_done == 11) )
+    {
+        printf_P(PSTR("{\"unsub\":\"%s\"}\r\n"), arg[0]);
+        initCommandBuffer();
+    }
+    else
+    {
+        printf_P(PSTR("{\"err\":\"UnsubCmdDnWTF\"}\r\n"));
+        initCommandBuffer();
+    }
+}
+
+/* /0/sub? gives {"sub":[{"id":"0","k":"adc","m":"255","ms":"100","n":"42"}]} */
+void Subscriptions(void)
+{
+    if ( (command_done == 10) )
+    {
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 20;
+    }
+    else if ( (command_done == 20) )
+    {
+        json_pass();
+        json_obj_begin();
+        json_key_P(PSTR("sub"));
+        json_arr_begin();
+        for (uint8_t id = 0; id < SUB_SLOTS; id++)
+        {
+            struct Sub_Slot *slot = &sub_slot[id];
+            if (slot->kind == SUB_KIND_NONE) continue;
+            json_obj_begin();
+            json_key_P(PSTR("id"));
+            json_uint(id);
+            json_key_P(PSTR("k"));
+            json_str_P( (slot->kind == SUB_KIND_ADC) ? PSTR("adc") : PSTR("din") );
+            json_key_P(PSTR("m"));
+            json_uint(slot->mask);
+            json_key_P(PSTR("ms"));
+            json_uint(slot->period_ms);
+            json_key_P(PSTR("n"));
+            json_uint(slot->seq);
+            if (slot->deadband)
+            {
+                json_key_P(PSTR("db"));
+                json_uint(slot->deadband);
+                json_key_P(PSTR("kf"));
+                json_uint(slot->keyframe);
+            }
+            json_obj_end();
+        }
+        json_arr_end();
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        printf_P(PSTR("{\"err\":\"SubCmdDnWTF\"}\r\n"));
+        initCommandBuffer();
+    }
+}
+
+// a frame is going out, hold off on input until it is done
+uint8_t sub_pushing(void)
+{
+    return (sub_push_id < SUB_SLOTS);
+}
+
+// sample adc channels into a full frame, or a delta frame of the channels that moved past the deadband.
+// Returns 0 if there is nothing to send.
+static uint8_t adc_sample(struct Sub_Slot *slot)
+{
+    uint8_t key = ( (!slot->deadband) || (!slot->seq) || (slot->since_key >= slot->keyframe) );
+    sub_frame_count = 0;
+    sub_frame_delta = 0;
+    static struct Adc_Snapshot burst; // all the channels of a frame are from one burst
+    adcSnapshot(&burst);
+    for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+    {
+        if ( !(slot->mask & (1<<ch)) ) continue;
+        int32_t value = burst.adc[ch];
+        if (key)
+        {
+            sub_frame[sub_frame_count++] = value;
+            slot->sent[ch] = value;
+        }
+        else
+        {
+            int32_t delta = value - slot->sent[ch];
+            if ( (delta > (int32_t)slot->deadband) || (delta < -((int32_t)slot->deadband)) )
+            {
+                sub_frame[sub_frame_count++] = delta;
+                sub_frame_delta |= (1<<ch);
+                slot->sent[ch] = value;
+            }
+        }
+    }
+    if (key)
+    {
+        slot->since_key = 0;
+        return 1;
+    }
+    slot->since_key++; // counts periods, so a quiet channel still gets a full frame now and then
+    return (sub_frame_delta != 0);
+}
+
+// sample the next subscription that is due, returns 0 if none are
+static uint8_t sub_sample(void)
+{
+    for (uint8_t i = 0; i < SUB_SLOTS; i++)
+    {
+        uint8_t id = (sub_next + i) % SUB_SLOTS;
+        struct Sub_Slot *slot = &sub_slot[id];
+        if (slot->kind == SUB_KIND_NONE) continue;
+        unsigned long kRuntime = elapsed(&slot->last);
+        if (kRuntime < slot->period) continue;
+
+        // keep the schedule, but do not try to catch up after falling behind
+        slot->last += slot->period;
+        if (kRuntime > (slot->period << 1)) slot->last = tickAtomic();
+
+        if (slot->kind == SUB_KIND_ADC)
+        {
+            if ( !adc_sample(slot) ) continue;
+        }
+        else
+        {
+            // din only pushes a change (and the first frame)
+            uint8_t levels = din_levels(slot->mask);
+            if ( slot->seq && (levels == slot->levels) ) continue;
+            slot->levels = levels;
+        }
+        sub_push_id = id;
+        sub_next = id + 1;
+        json_start(JSON_QUOTE_NUMBERS);
+        return 1;
+    }
+    return 0;
+}
+
+// frames are {"s":"0","n":"12","ADC":["4095","2048"]} or {"s":"1","n":"3","lvl":"165"}
+// a delta frame has the channels that moved and how much {"s":"0","n":"13","m":"2","d":["-12"]}
+void SubPush(void)
+{
+    if ( !sub_pushing() && !sub_sample() ) return;
+
+    struct Sub_Slot *slot = &sub_slot[sub_push_id];
+    json_pass();
+    json_obj_begin();
+    json_key_P(PSTR("s"));
+    json_uint(sub_push_id);
+    json_key_P(PSTR("n"));
+    json_uint(slot->seq);
+    if (slot->kind == SUB_KIND_DIN)
+    {
+        json_key_P(PSTR("lvl"));
+        json_uint(slot->levels);
+    }
+    else if (sub_frame_delta)
+    {
+        json_key_P(PSTR("m"));
+        json_uint(sub_frame_delta);
+        json_key_P(PSTR("d"));
+        json_arr_begin();
+        for (uint8_t i = 0; i < sub_frame_count; i++)
+        {
+            json_int(sub_frame[i]);
+        }
+        json_arr_end();
+    }
+    else
+    {
+        json_key_P(PSTR("ADC"));
+        json_arr_begin();
+        for (uint8_t i = 0; i < sub_frame_count; i++)
+        {
+            json_int(sub_frame[i]);
+        }
+        json_arr_end();
+    }
+    json_obj_end();
+    json_eol();
+    if (json_blocked()) return; // next pass when the serial buffer has room
+    slot->seq++;
+    sub_push_id = SUB_SLOTS;
+}
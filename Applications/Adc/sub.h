@@ -0,0 +1,26 @@
+#ifndef Sub_H
+#define Sub_H
+
+// subscriptions that can run at the same time
+#define SUB_SLOTS 4
+
+// in delta mode a full frame is sent after this many periods if a keyframe count is not given
+#define SUB_KEYFRAME_DEFAULT 50
+
+// fastest period a subscription can have
+#define SUB_MIN_PERIOD_MILSEC 10UL
+
+typedef enum SUB_KIND_enum
+{
+    SUB_KIND_NONE,
+    SUB_KIND_ADC, // push adc readings on schedule
+    SUB_KIND_DIN // push digital levels on change
+} SUB_KIND_t;
+
+extern void Subscribe(void);
+extern void Unsubscribe(void);
+extern void Subscriptions(void);
+extern void SubPush(void);
+extern uint8_t sub_pushing(void);
+
+#endif // Sub_H
@@ -1,28 +1,26 @@
-/*
-    \file   main.c
+/* ADC throughput benchmark
+Copyright (C) 2021 Ronald Sutherland
 
-    \brief  ADC Single Conversion
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
 
-    (c) 2019 Microchip Technology Inc. and its subsidiaries.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
-    Subject to your compliance with these terms, you may use Microchip software and any
-    derivatives exclusively with Microchip products. It is your responsibility to comply with third-party
-    license terms applicable to your use of third-party software (including open source software) that
-    may accompany Microchip software.
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
 
-    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
-    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
-    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
-    FOR A PARTICULAR PURPOSE.
-
-    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
-    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
-    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
-    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
-    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
-    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
-    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
-    SOFTWARE.
+Started from the Microchip ADC Single Conversion example, which printed each reading and so
+measured the UART. Now each row of bench_conf runs the ADC for one second on AIN0 with nothing
+printed, then a row of the table is printed. The main loop counts how many times it spins while the
+ADC ISR runs, against the idle row (no ADC), which gives the CPU load and the cycles each result
+costs with the ISR entry and exit. TCB1 counts CLK_PER so the ISR body is also timed.
+The adc rows run the ISR of ../lib/adc_bsd.c (built with ADC_ISR_PROBE so it is a function this ISR
+calls) on all eight channels with the median filter, statistics, and capture on, so its cost can be
+compared with the ADC_ISR_*_CLKS budget in adc_bsd.h.
 */
 
 #include <avr/io.h>
@@ -30,153 +28,101 @@
 #include <stdlib.h>
 #include <avr/pgmspace.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "../lib/timers_bsd.h"
 #include "../lib/uart0_bsd.h"
 #include "../lib/io_enum_bsd.h"
+#define ADC_ISR_PROBE // adc_probe.o is adc_bsd.c built with it (see the Makefile)
+#include "../lib/adc_bsd.h"
+#include "../lib/references.h"
 
-uint16_t adcVal;
-uint8_t adc_print_per_line;
+// each row runs for one second of ticksFine
+#define BENCH_RUN_FINE (F_CPU / TICK_FINE_CLOCKS)
 
-// enumeraiton names for ADC_CH_<node> from schematic
-typedef enum ADC_CH_enum {
-    ADC_CH_ADC0, // this channels measures AIN0 to GND, AIN0 is on pin PD0
-    ADC_CH_ADC1, // this channels measures AIN1 to GND, AIN1 is on pin PD1
-    ADC_CH_ADC2, // this channels measures AIN2 to GND, AIN2 is on pin PD2
-    ADC_CH_ADC3, // this channels measures AIN3 to GND, AIN3 is on pin PD3
-    ADC_CH_ADC4, // this channels measures AIN4 to GND, AIN4 is on pin PD4
-    ADC_CH_ADC5, // this channels measures AIN5 to GND, AIN5 is on pin PD5
-    ADC_CH_ADC6, // this channels measures AIN6 to GND, AIN6 is on pin PD6
-    ADC_CH_ADC7, // this channels measures AIN7 to GND, AIN7 is on pin PD7
-    ADC_CHANNELS
-} ADC_CH_t;
+// AIN0 is on pin PD0
+#define BENCH_MUXPOS ADC_MUXPOS_AIN0_gc
 
-ADC_CH_t adc_ch;
+typedef enum BENCH_MODE_enum {
+    BENCH_IDLE, // no ADC, the baseline for the load
+    BENCH_FREE, // free running
+    BENCH_ACCUM, // free running with results accumulated by the ADC
+    BENCH_EVENT, // a conversion started by each TCB2 event
+    BENCH_ADC, // the adc_bsd ISR free running on the scan plan
+    BENCH_ADCEV // the adc_bsd ISR with enable_ADC_event_conversion, event_hz is for each channel
+} BENCH_MODE_t;
 
-typedef enum CALIBRATE_LOADED_enum
-{
-    CALIBRATE_LOADED_NO,  // not loaded and not started
-    CALIBRATE_LOADED_CH0,  // work in prcess, load channel 0 and set reference
-    CALIBRATE_LOADED_CH1,  // work in prcess, load channel 1 and set reference
-    CALIBRATE_LOADED_CH2,  // work in prcess, load channel 2 and set reference
-    CALIBRATE_LOADED_CH3,  // work in prcess, load channel 3 and set reference
-    CALIBRATE_LOADED_CH4,  // work in prcess, load channel 4 and set reference
-    CALIBRATE_LOADED_CH5,  // work in prcess, load channel 5 and set reference
-    CALIBRATE_LOADED_CH6,  // work in prcess, load channel 6 and set reference
-    CALIBRATE_LOADED_CH7,  // work in prcess, load channel 7 and set reference
-    CALIBRATE_LOADED_DONE,  // calibrations loaded and references set
-    CALIBRATE_LOADED_ERR  // Fail to load calibrations
-} CALIBRATE_LOADED_t;
+static const char bench_mode_names[][6] PROGMEM = {"idle", "free", "accum", "event", "adc", "adcev"};
+
+struct Bench_Conf {
+    BENCH_MODE_t mode;
+    ADC_PRESC_t presc;
+    uint16_t div; // presc as a number for the table
+    uint8_t sampctrl; // sample time added in ADC clocks
+    ADC_SAMPNUM_t sampnum; // results accumulated are 1 << sampnum
+    uint32_t event_hz; // event rate in BENCH_EVENT mode
+};
 
-struct AdcConf_Map { 
-    float calibration; // calibrated value need for an ADC divion of the channel.
-    float *ref; // pointer to the referance value used for channel
-    VREF_REFSEL_t adc0ref; // Setting for ADC0 Reference register
-    ADC_MUXPOS_t muxpos; // Setting for ADC0 Positive mux input register
-    ADC_MUXNEG_t muxneg; // Setting for ADC0 Negative mux input register
-    uint8_t sampctrl; // Extend the ADC sampling time beyond the default two clocks
+// 2 MHz is the fastest ADC clock for 12-bit results, DIV8 at 16MHz
+static const struct Bench_Conf bench_conf[] PROGMEM = {
+    {BENCH_IDLE, ADC_PRESC_DIV8_gc, 0, 0, ADC_SAMPNUM_NONE_gc, 0},
+    {BENCH_FREE, ADC_PRESC_DIV8_gc, 8, 0, ADC_SAMPNUM_NONE_gc, 0},
+    {BENCH_FREE, ADC_PRESC_DIV16_gc, 16, 0, ADC_SAMPNUM_NONE_gc, 0},
+    {BENCH_FREE, ADC_PRESC_DIV32_gc, 32, 0, ADC_SAMPNUM_NONE_gc, 0},
+    {BENCH_FREE, ADC_PRESC_DIV64_gc, 64, 0, ADC_SAMPNUM_NONE_gc, 0},
+    {BENCH_FREE, ADC_PRESC_DIV8_gc, 8, 8, ADC_SAMPNUM_NONE_gc, 0},
+    {BENCH_FREE, ADC_PRESC_DIV8_gc, 8, 32, ADC_SAMPNUM_NONE_gc, 0},
+    {BENCH_ACCUM, ADC_PRESC_DIV8_gc, 8, 0, ADC_SAMPNUM_ACC4_gc, 0},
+    {BENCH_ACCUM, ADC_PRESC_DIV8_gc, 8, 0, ADC_SAMPNUM_ACC16_gc, 0},
+    {BENCH_ACCUM, ADC_PRESC_DIV8_gc, 8, 0, ADC_SAMPNUM_ACC64_gc, 0},
+    {BENCH_ACCUM, ADC_PRESC_DIV16_gc, 16, 8, ADC_SAMPNUM_ACC16_gc, 0},
+    {BENCH_EVENT, ADC_PRESC_DIV8_gc, 8, 0, ADC_SAMPNUM_NONE_gc, 10000},
+    {BENCH_EVENT, ADC_PRESC_DIV8_gc, 8, 0, ADC_SAMPNUM_NONE_gc, 50000},
+    {BENCH_EVENT, ADC_PRESC_DIV8_gc, 8, 0, ADC_SAMPNUM_NONE_gc, 100000},
+    {BENCH_EVENT, ADC_PRESC_DIV16_gc, 16, 0, ADC_SAMPNUM_NONE_gc, 50000},
+    {BENCH_ADC, ADC_PRESC, ADC_PRESC_DIV, 0, ADC_SAMPNUM_NONE_gc, 0},
+    {BENCH_ADCEV, ADC_PRESC, ADC_PRESC_DIV, 0, ADC_SAMPNUM_NONE_gc, 250},
+    {BENCH_ADCEV, ADC_PRESC, ADC_PRESC_DIV, 0, ADC_SAMPNUM_NONE_gc, 500}
 };
+#define BENCH_ROWS (sizeof(bench_conf) / sizeof(bench_conf[0]))
 
-CALIBRATE_LOADED_t cal_loaded;
-struct AdcConf_Map adcConfMap[ADC_CHANNELS]; // size is ADC_CHANNELS
-float ref_extern_vdd;
+static volatile uint32_t bench_results; // ISR count
+static volatile uint32_t bench_sum; // of the results, for the mean
+static volatile uint32_t bench_cycles; // ISR body cycles summed
+static volatile uint16_t bench_cycles_max;
+static volatile uint16_t bench_select_max; // adc rows, ISR body cycles to the mux select of the next channel
+static volatile uint16_t bench_end_max; // adc rows, ISR body cycles of a reading that ends a burst
+static uint8_t bench_lib; // the adc_bsd ISR is running
+static uint16_t tcb_read_cycles; // cost of the TCB1 reads, taken off each timing
+static uint32_t idle_base; // loops of the idle row
 
-// Load the hardware setting for ADC channel operation
-// TODO: load calibrations from manager over I2C
-CALIBRATE_LOADED_t LoadAdcConfig()
+ISR(ADC0_RESRDY_vect)
 {
-    uint16_t i2c_success = 1; // i2c will take several scan loops to finish each cal. It is a place holder for the code.
-    ADC_CH_t ch; // channels may be differential or internal things (TEMPSENSE, DAC, REF0...)
-    switch (cal_loaded)
+    uint16_t start = TCB1.CNT;
+    if (bench_lib)
     {
-    case CALIBRATE_LOADED_NO:
-        ch = ADC_CH_ADC0;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN0_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH0;
-        break;
-    case CALIBRATE_LOADED_CH0:
-        ch = ADC_CH_ADC1;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN1_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH1;
-        break;
-    case CALIBRATE_LOADED_CH1:
-        ch = ADC_CH_ADC2;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN2_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH2;
-        break;
-    case CALIBRATE_LOADED_CH2:
-        ch = ADC_CH_ADC3;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN3_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH3;
-        break;
-    case CALIBRATE_LOADED_CH3:
-        ch = ADC_CH_ADC4;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN4_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH4;
-        break;
-    case CALIBRATE_LOADED_CH4:
-        ch = ADC_CH_ADC5;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN5_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH5;
-        break;
-    case CALIBRATE_LOADED_CH5:
-        ch = ADC_CH_ADC6;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN6_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH6;
-        break;
-    case CALIBRATE_LOADED_CH6:
-        ch = ADC_CH_ADC7;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN7_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH7;
-        break;
-    case CALIBRATE_LOADED_CH7:
-        cal_loaded = CALIBRATE_LOADED_DONE;
-        break;
-
-    default:
-        cal_loaded = CALIBRATE_LOADED_ERR;
-        break;
+        uint8_t front = adc_snap_front;
+        adc_isr();
+        uint16_t cycles = TCB1.CNT - start - tcb_read_cycles;
+        uint16_t select = adc_isr_selected - start - tcb_read_cycles;
+        bench_results++;
+        bench_cycles += cycles;
+        if (adc_event_rate && (select > bench_select_max)) bench_select_max = select;
+        if (front != adc_snap_front)
+        {
+            if (cycles > bench_end_max) bench_end_max = cycles;
+        }
+        else if (cycles > bench_cycles_max)
+        {
+            bench_cycles_max = cycles;
+        }
+        return;
     }
-
-    return cal_loaded;
+    uint16_t res = ADC0.RES; // clears the interrupt flag
+    bench_sum += res;
+    bench_results++;
+    uint16_t cycles = TCB1.CNT - start - tcb_read_cycles;
+    bench_cycles += cycles;
+    if (cycles > bench_cycles_max) bench_cycles_max = cycles;
 }
 
 void PORT_init(void)
@@ -200,72 +146,215 @@ void PORT_init(void)
     ioCntl(MCU_IO_AIN7, PORT_ISC_INPUT_DISABLE_gc, PORT_PULLUP_DISABLE, PORT_INVERT_NORMAL);
 }
 
-void ADC0_init(void)
+// TCB1 counts CLK_PER from 0 to 0xFFFF and wraps, its interrupt is not used
+void TCB1_init(void)
 {
-    ADC0.CTRLD = ADC_INITDLY_DLY16_gc;     // let referance settle
-    VREF.ADC0REF = VREF_REFSEL_VDD_gc; 
+    TCB1.CTRLA = 0;
+    TCB1.CTRLB = TCB_CNTMODE_INT_gc;
+    TCB1.CCMP = 0xFFFF;
+    TCB1.CNT = 0;
+    TCB1.CTRLA = TCB_CLKSEL_DIV1_gc | TCB_ENABLE_bm;
+
+    uint16_t start = TCB1.CNT;
+    tcb_read_cycles = TCB1.CNT - start;
+}
 
-    // load config and calibration or set error
-    cal_loaded = CALIBRATE_LOADED_NO;
-    while(cal_loaded < CALIBRATE_LOADED_DONE)
+void ADC0_start(const struct Bench_Conf *conf)
+{
+    ADC0.CTRLA = 0;                          // disabled
+    VREF.ADC0REF = VREF_REFSEL_VDD_gc;       // Select referance
+    ADC0.CTRLB = conf->sampnum;              // results accumulated
+    ADC0.CTRLC = conf->presc;                // CLK_PER divided for the ADC clock
+    ADC0.CTRLD = ADC_INITDLY_DLY16_gc;       // let referance settle
+    ADC0.SAMPCTRL = conf->sampctrl;          // extend the sampling time beyond the default two clocks
+    ADC0.MUXPOS = BENCH_MUXPOS;              // Select ADC channel
+    ADC0.MUXNEG = ADC_MUXNEG_GND_gc;
+    ADC0.INTFLAGS = ADC_RESRDY_bm;
+    ADC0.INTCTRL = ADC_RESRDY_bm;            // Enable interrupts
+    if (conf->mode == BENCH_EVENT)
+    {
+        // TCB2 makes a capture event each period, event channel 2 takes it to the ADC start input
+        TCB2.CTRLA = 0;
+        EVSYS.CHANNEL2 = EVSYS_CHANNEL2_TCB2_CAPT_gc;
+        EVSYS.USERADC0START = EVSYS_USER_CHANNEL2_gc;
+        ADC0.EVCTRL = ADC_STARTEI_bm;
+        ADC0.CTRLA = ADC_RESSEL_12BIT_gc | ADC_ENABLE_bm;
+        TCB2.CCMP = (uint16_t)(F_CPU / conf->event_hz - 1);
+        TCB2.CNT = 0;
+        TCB2.CTRLB = TCB_CNTMODE_INT_gc;
+        TCB2.CTRLA = TCB_CLKSEL_DIV1_gc | TCB_ENABLE_bm;
+    }
+    else
     {
-        LoadAdcConfig();
+        ADC0.CTRLA = ADC_RESSEL_12BIT_gc | ADC_FREERUN_bm | ADC_ENABLE_bm;
+        ADC0.COMMAND = ADC_STCONV_bm;        // Start ADC conversion
     }
 }
 
-uint16_t ADC0_read(void)
+// the adc_bsd ISR on the scan plan of all eight channels, with the worst case work it can have on each reading
+void adc_lib_start(const struct Bench_Conf *conf)
 {
-    /* Clear the interrupt flag by reading the result */
-    return ADC0.RES;
+    init_ADC_single_conversion(); // the rows before this one set the ADC registers
+    adc_scan_set(0xFF, 1);
+    for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+    {
+        adc_filter_set( (ADC_CH_t) ch, ADC_FILTER_MEDIAN, 5);
+    }
+    adc_stat_start(0xFF, 10); // a short window so the flip is in the row
+    adc_capture_start(0xFF, 0);
+    bench_lib = 1;
+    if (conf->mode == BENCH_ADCEV)
+    {
+        if (!enable_ADC_event_conversion( (uint16_t) conf->event_hz))
+        { // over the budget, the row is zeros
+            adc_capture_stop();
+            adc_stat_start(0, 0);
+            bench_lib = 0;
+        }
+    }
+    else
+    {
+        enable_ADC_auto_conversion(FREE_RUNNING);
+    }
 }
 
-void ADC0_start(ADC_CH_t ch)
+void adc_lib_stop(void)
 {
-    ADC0.COMMAND = ADC_SPCONV_bm;            // Stop ADC conversion to get a clean value
-    ADC0.CTRLA  = 0;                         // disabled
-    VREF.ADC0REF = adcConfMap[ch].adc0ref;   // Select referance
-    ADC0.CTRLA = ADC_RESSEL_12BIT_gc;        // 12-bit mode
-    ADC0.CTRLC = ADC_PRESC_DIV4_gc;          // CLK_PER divided by 4 (e.g. F_CPU/4 = 1 MHz)
-    ADC0.MUXPOS = adcConfMap[ch].muxpos;     // Select ADC channel
-    ADC0.CTRLA |= ADC_ENABLE_bm;             // ADC Enabled
-    ADC0.COMMAND = ADC_STCONV_bm;            // Start ADC conversion
+    if (adc_event_rate)
+    {
+        disable_ADC_event_conversion();
+    }
+    else
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            enable_ADC_auto_conversion(BURST_MODE); // ends free running after one more burst
+        }
+        while (adc_isr_status != ISR_ADCBURST_DONE);
+    }
+    adc_capture_stop();
+    adc_stat_start(0, 0);
+    bench_lib = 0;
+}
+
+void ADC0_stop(void)
+{
+    TCB2.CTRLA = 0;
+    ADC0.EVCTRL = 0;
+    EVSYS.USERADC0START = 0;
+    ADC0.INTCTRL = 0;
+    ADC0.COMMAND = ADC_SPCONV_bm;
+    ADC0.CTRLA = 0;
+}
+
+void bench_header(void)
+{
+    printf_P(PSTR("\r\nmode   div  kHz samp   n   res/s   smp/s  isr  max  load%%  cyc/res   miss  mean   sel   end\r\n"));
+}
+
+// ticksFine() must be read with interrupts off, or the tick ISR can tear it or step it back
+static unsigned long bench_ticks(void)
+{
+    unsigned long now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        now = ticksFine();
+    }
+    return now;
+}
+
+// run one row of bench_conf for a second and print its results
+void bench_run(uint8_t row)
+{
+    struct Bench_Conf conf;
+    memcpy_P(&conf, &bench_conf[row], sizeof(conf));
+
+    uart0_flush(); // the UART ISR would add to the load
+    cli();
+    bench_results = 0;
+    bench_sum = 0;
+    bench_cycles = 0;
+    bench_cycles_max = 0;
+    bench_select_max = 0;
+    bench_end_max = 0;
+    sei();
+
+    if ( (conf.mode == BENCH_ADC) || (conf.mode == BENCH_ADCEV) )
+    {
+        adc_lib_start(&conf);
+        conf.sampctrl = adcConfMap[ADC_CH_ADC0].sampctrl; // the table shows what the ADC used
+        conf.sampnum = adcConfMap[ADC_CH_ADC0].sampnum;
+        if (conf.mode == BENCH_ADCEV) conf.event_hz *= adc_scan_len; // misses are counted against all the events
+    }
+    else if (conf.mode != BENCH_IDLE)
+    {
+        ADC0_start(&conf);
+    }
+    uint32_t idle = 0;
+    unsigned long start = bench_ticks();
+    while ( (bench_ticks() - start) < BENCH_RUN_FINE )
+    {
+        idle++;
+    }
+    if (bench_lib)
+    {
+        adc_lib_stop();
+    }
+    else
+    {
+        ADC0_stop();
+    }
+    if (conf.mode == BENCH_IDLE) idle_base = idle;
+
+    uint32_t results = bench_results; // the ADC ISR is stopped
+    uint32_t lost = (idle < idle_base) ? (idle_base - idle) : 0; // loops the ISR took
+    uint16_t load = idle_base ? (uint16_t)( ((uint64_t)lost * 1000) / idle_base ) : 0; // tenths of a percent
+    uint32_t cyc_res = (idle_base && results) ? (uint32_t)( ((uint64_t)lost * F_CPU) / idle_base / results ) : 0;
+    uint32_t miss = ( ( (conf.mode == BENCH_EVENT) || (conf.mode == BENCH_ADCEV) ) && (conf.event_hz > results) ) ? (conf.event_hz - results) : 0;
+    uint32_t mean = results ? (bench_sum / results) : 0UL;
+    if ( (conf.mode == BENCH_ADC) || (conf.mode == BENCH_ADCEV) ) mean = adc[ADC_CH_ADC0]; // the last reading of AIN0
+
+    printf_P(PSTR("%-5S %4u %4lu %4u %3u %7lu %7lu %4lu %4u %3u.%u %8lu %6lu %5lu %5u %5u\r\n"),
+        bench_mode_names[conf.mode],
+        conf.div,
+        conf.div ? (F_CPU / conf.div / 1000UL) : 0UL,
+        conf.sampctrl,
+        (conf.mode == BENCH_IDLE) ? 0 : (1 << conf.sampnum),
+        results,
+        results << conf.sampnum,
+        results ? (bench_cycles / results) : 0UL,
+        bench_cycles_max,
+        load / 10, load % 10,
+        cyc_res,
+        miss,
+        mean,
+        bench_select_max,
+        bench_end_max);
 }
 
 int main(void)
 {
-    ref_extern_vdd = 5.0;
+    // TCA0_HUNF used for timing (ticksFine), it also sets the F_CPU clock
+    initTimers();
     PORT_init();
-    ADC0_init();
-    adc_ch = ADC_CH_ADC0;
-    ADC0_start(adc_ch);
+    init_ADC_single_conversion(); // references and channel settings from EEPROM for the adc rows
+    TCB1_init();
 
     /* Initialize UART, it returns a pointer to FILE so redirect of stdin and stdout works*/
-    stderr = stdout = stdin = uart0_init(9600UL, UART0_RX_REPLACE_CR_WITH_NL);
+    stderr = stdout = stdin = uart0_init(38400UL, UART0_RX_REPLACE_CR_WITH_NL);
 
-    // Enable global interrupts to start UART ISR
+    // Enable global interrupts to start TIMER0 and UART ISR's
     sei();
 
     while (1)
     {
-        if (ADC0.INTFLAGS & ADC_RESRDY_bm) // Check if the conversion is done
+        bench_header();
+        for (uint8_t row = 0; row < BENCH_ROWS; row++)
         {
-            if (uart0_availableForWrite()) 
-            {
-                adcVal = ADC0_read();
-                printf_P(PSTR("  %d\t"), adcVal);
-                if (adc_ch >= ADC_CH_ADC7)
-                {
-                    printf_P(PSTR("\r\n"));
-                    adc_ch = ADC_CH_ADC0;
-                }
-                else
-                {
-                    adc_ch++;
-                }
-                ADC0_start(adc_ch); // Start the next ADC conversion
-            }
+            bench_run(row);
         }
+        printf_P(PSTR("send a char to run again\r\n"));
+        while (!uart0_available());
+        while (uart0_available()) getchar();
     }
 }
-
-
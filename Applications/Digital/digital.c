@@ -27,41 +27,63 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 
 #define SERIAL_PRINT_DELAY_MILSEC 10000
 
-// pin number must be valid in arg[0] from parse
-void echo_io_pin_in_json_rply(void)
+// arg[0] is the AIN0..AIN7 enum value for all the commands
+static const char dir_tokens[] PROGMEM = "INPUT\0OUTPUT\0"; // index is DIRECTION_t
+static const char level_tokens[] PROGMEM = "LOW\0HIGH\0"; // index is LOGIC_LEVEL_t
+
+static const struct Arg_Schema dir_schema[] PROGMEM = {
+    {ARG_TYPE_UINT32, MCU_IO_AIN0, MCU_IO_AIN7, NULL},
+    {ARG_TYPE_TOKEN, 0, 0, dir_tokens}
+};
+
+static const struct Arg_Schema wrt_schema[] PROGMEM = {
+    {ARG_TYPE_UINT32, MCU_IO_AIN0, MCU_IO_AIN7, NULL},
+    {ARG_TYPE_TOKEN, 0, 0, level_tokens}
+};
+
+static const struct Arg_Schema pin_schema[] PROGMEM = {
+    {ARG_TYPE_UINT32, MCU_IO_AIN0, MCU_IO_AIN7, NULL}
+};
+
+// or arg[0] is a batch of pins, e.g., all, 0-3 or 0xF0
+static const struct Arg_Schema dir_batch_schema[] PROGMEM = {
+    {ARG_TYPE_SET, MCU_IO_AIN0, MCU_IO_AIN7, NULL},
+    {ARG_TYPE_TOKEN, 0, 0, dir_tokens}
+};
+
+static const struct Arg_Schema wrt_batch_schema[] PROGMEM = {
+    {ARG_TYPE_SET, MCU_IO_AIN0, MCU_IO_AIN7, NULL},
+    {ARG_TYPE_TOKEN, 0, 0, level_tokens}
+};
+
+static const struct Arg_Schema pin_batch_schema[] PROGMEM = {
+    {ARG_TYPE_SET, MCU_IO_AIN0, MCU_IO_AIN7, NULL}
+};
+
+// pins of a batch command, bit n is AINn
+static uint8_t io_batch_mask;
+
+// levels of the batch pins as a mask, bit n is HIGH when AINn is read HIGH
+static uint8_t io_batch_levels(void)
 {
-    if (atoi(arg[0]) == 0) 
-    {
-        printf_P(PSTR("AIN0"));
-    }
-    if (atoi(arg[0]) == 1) 
-    {
-        printf_P(PSTR("AIN1"));
-    }
-    if (atoi(arg[0]) == 2)
-    {
-        printf_P(PSTR("AIN2"));
-    }
-    if (atoi(arg[0]) == 3) 
-    {
-        printf_P(PSTR("AIN3"));
-    }
-    if (atoi(arg[0]) == 4)
-    {
-        printf_P(PSTR("AIN4"));
-    }
-    if (atoi(arg[0]) == 5)
-    {
-        printf_P(PSTR("AIN5"));
-    }
-    if (atoi(arg[0]) == 6)
-    {
-        printf_P(PSTR("AIN6"));
-    }
-    if (atoi(arg[0]) == 7)
+    uint8_t levels = 0;
+    for (uint8_t pin = MCU_IO_AIN0; pin <= MCU_IO_AIN7; pin++)
     {
-        printf_P(PSTR("AIN7"));
+        if ( (io_batch_mask & (1<<pin)) && ioRead( (MCU_IO_t) pin) ) levels |= (1<<pin);
     }
+    return levels;
+}
+
+// batch reply e.g., {"m":"15","lvl":"5"}
+static void echo_io_batch_levels_in_json_rply(void)
+{
+    printf_P(PSTR("{\"m\":\"%u\",\"lvl\":\"%u\"}\r\n"), io_batch_mask, io_batch_levels());
+}
+
+// pin number must be valid in arg_val[0] from typeArguments
+void echo_io_pin_in_json_rply(void)
+{
+    printf_P(PSTR("AIN%d"), (int) arg_val[0].u32);
 }
 
 // set io direction (DIRECTION_INPUT or DIRECTION_OUTPUT)
@@ -70,36 +92,35 @@ void Direction(void)
 {
     if ( (command_done == 10) )
     {
-        // check that arg[0] is a digit 
-        if ( ( !( isdigit(arg[0][0]) ) ) )
+        // check that arg[0] is AIN0..AIN7 (or a batch of them) and arg[1] is INPUT|OUTPUT
+        if ( !typeArguments(is_arg_batch(0) ? dir_batch_schema : dir_schema, 2) )
         {
-            printf_P(PSTR("{\"err\":\"ioDirNaN\"}\r\n"));
+            if (arg_err_index == 1)
+            {
+                printf_P(PSTR("{\"err\":\"ioDirNaInOut\"}\r\n"));
+            }
+            else if (arg_err == ARG_ERR_NAN)
+            {
+                printf_P(PSTR("{\"err\":\"ioDirNaN\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"err\":\"ioDirOutOfRng\"}\r\n"));
+            }
             initCommandBuffer();
             return;
         }
-        // and arg[0] value is AIN0..AIN7
-        uint8_t a = atoi(arg[0]);
-        if ( (a < MCU_IO_AIN0) || (a > MCU_IO_AIN7) )
+        if (is_arg_batch(0))
         {
-            printf_P(PSTR("{\"err\":\"ioDirOutOfRng\"}\r\n"));
-            initCommandBuffer();
+            io_batch_mask = (uint8_t) arg_val[0].set;
+            for (uint8_t pin = MCU_IO_AIN0; pin <= MCU_IO_AIN7; pin++)
+            {
+                if (io_batch_mask & (1<<pin)) ioDir( (MCU_IO_t) pin, (DIRECTION_t) arg_val[1].token);
+            }
+            command_done = 20;
             return;
         }
-        // also arg[1] is not ('INPUT' or 'OUTPUT')
-        if ( !( (strcmp_P( arg[1], PSTR("INPUT")) == 0) || (strcmp_P( arg[1], PSTR("OUTPUT")) == 0) ) ) 
-        {
-            printf_P(PSTR("{\"err\":\"ioDirNaInOut\"}\r\n"));
-            initCommandBuffer();
-            return;
-        }
-        if (strcmp_P( arg[1], PSTR("OUTPUT")) == 0 ) 
-        {
-            ioDir( (MCU_IO_t) a, DIRECTION_OUTPUT);
-        }
-        else
-        {
-            ioDir( (MCU_IO_t) a, DIRECTION_INPUT);
-        }
+        ioDir( (MCU_IO_t) arg_val[0].u32, (DIRECTION_t) arg_val[1].token);
         
         printf_P(PSTR("{\""));
         command_done = 11;
@@ -116,6 +137,11 @@ void Direction(void)
         printf_P(PSTR("\"}\r\n"));
         initCommandBuffer();
     }
+    else if ( (command_done == 20) )
+    { // batch reply e.g., {"m":"15","dir":"OUTPUT"}
+        printf_P(PSTR("{\"m\":\"%u\",\"dir\":\"%s\"}\r\n"), io_batch_mask, arg[1]);
+        initCommandBuffer();
+    }
     else
     {
         printf_P(PSTR("{\"err\":\"ioDirCmdDnWTF\"}\r\n"));
@@ -129,36 +155,35 @@ void Write(void)
 {
     if ( (command_done == 10) )
     {
-        // check that arg[0] is the io_enum value 
-        if ( ( !( isdigit(arg[0][0]) ) ) )
-        {
-            printf_P(PSTR("{\"err\":\"ioWrtNaN\"}\r\n"));
-            initCommandBuffer();
-            return;
-        }
-        // and arg[0] value is AIN0..AIN7
-        uint8_t a = atoi(arg[0]);
-        if ( (a < MCU_IO_AIN0) || (a > MCU_IO_AIN7) )
+        // check that arg[0] is AIN0..AIN7 (or a batch of them) and arg[1] is HIGH|LOW
+        if ( !typeArguments(is_arg_batch(0) ? wrt_batch_schema : wrt_schema, 2) )
         {
-            printf_P(PSTR("{\"err\":\"ioWrtOutOfRng\"}\r\n"));
+            if (arg_err_index == 1)
+            {
+                printf_P(PSTR("{\"err\":\"ioWrtNaState\"}\r\n"));
+            }
+            else if (arg_err == ARG_ERR_NAN)
+            {
+                printf_P(PSTR("{\"err\":\"ioWrtNaN\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"err\":\"ioWrtOutOfRng\"}\r\n"));
+            }
             initCommandBuffer();
             return;
         }
-        // also arg[1] is not ('HIGH' or 'LOW')
-        if ( !( (strcmp_P( arg[1], PSTR("HIGH")) == 0) || (strcmp_P( arg[1], PSTR("LOW")) == 0) ) ) 
+        if (is_arg_batch(0))
         {
-            printf_P(PSTR("{\"err\":\"ioWrtNaState\"}\r\n"));
-            initCommandBuffer();
+            io_batch_mask = (uint8_t) arg_val[0].set;
+            for (uint8_t pin = MCU_IO_AIN0; pin <= MCU_IO_AIN7; pin++)
+            {
+                if (io_batch_mask & (1<<pin)) ioWrite( (MCU_IO_t) pin, (LOGIC_LEVEL_t) arg_val[1].token);
+            }
+            command_done = 20;
             return;
         }
-        if (strcmp_P( arg[1], PSTR("HIGH")) == 0 ) 
-        {
-            ioWrite( (MCU_IO_t) a, LOGIC_LEVEL_HIGH);
-        }
-        else
-        {
-            ioWrite( (MCU_IO_t) a, LOGIC_LEVEL_LOW);
-        }
+        ioWrite( (MCU_IO_t) arg_val[0].u32, (LOGIC_LEVEL_t) arg_val[1].token);
         
         printf_P(PSTR("{\""));
         command_done = 11;
@@ -171,8 +196,7 @@ void Write(void)
     }
     else if ( (command_done == 12) )
     {
-        uint8_t a = atoi(arg[0]);
-        bool pin = ioRead( (MCU_IO_t) a);
+        bool pin = ioRead( (MCU_IO_t) arg_val[0].u32);
         if (pin)
         {
             printf_P(PSTR("HIGH"));
@@ -184,6 +208,11 @@ void Write(void)
         printf_P(PSTR("\"}\r\n"));
         initCommandBuffer();
     }
+    else if ( (command_done == 20) )
+    {
+        echo_io_batch_levels_in_json_rply();
+        initCommandBuffer();
+    }
     else
     {
         printf_P(PSTR("{\"err\":\"ioWrtCmdDnWTF\"}\r\n"));
@@ -197,22 +226,31 @@ void Toggle(void)
 {
     if ( (command_done == 10) )
     {
-        // check that arg[0] is a digit 
-        if ( ( !( isdigit(arg[0][0]) ) ) )
+        // check that arg[0] is AIN0..AIN7 (or a batch of them)
+        if ( !typeArguments(is_arg_batch(0) ? pin_batch_schema : pin_schema, 1) )
         {
-            printf_P(PSTR("{\"err\":\"ioTogNaN\"}\r\n"));
+            if (arg_err == ARG_ERR_NAN)
+            {
+                printf_P(PSTR("{\"err\":\"ioTogNaN\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"err\":\"ioTogOutOfRng\"}\r\n"));
+            }
             initCommandBuffer();
             return;
         }
-        // and arg[0] value is AIN0..AIN7
-        uint8_t a = atoi(arg[0]);
-        if ( (a < MCU_IO_AIN0) || (a > MCU_IO_AIN7) )
+        if (is_arg_batch(0))
         {
-            printf_P(PSTR("{\"err\":\"ioTogOutOfRng\"}\r\n"));
-            initCommandBuffer();
+            io_batch_mask = (uint8_t) arg_val[0].set;
+            for (uint8_t pin = MCU_IO_AIN0; pin <= MCU_IO_AIN7; pin++)
+            {
+                if (io_batch_mask & (1<<pin)) ioToggle( (MCU_IO_t) pin);
+            }
+            command_done = 20;
             return;
         }
-        ioToggle( (MCU_IO_t) a);
+        ioToggle( (MCU_IO_t) arg_val[0].u32);
         
         printf_P(PSTR("{\""));
         command_done = 11;
@@ -225,8 +263,7 @@ void Toggle(void)
     }
     else if ( (command_done == 12) )
     {
-        uint8_t a = atoi(arg[0]);
-        bool pin = ioRead( (MCU_IO_t) a);
+        bool pin = ioRead( (MCU_IO_t) arg_val[0].u32);
         if (pin)
         {
             printf_P(PSTR("HIGH"));
@@ -238,6 +275,11 @@ void Toggle(void)
         printf_P(PSTR("\"}\r\n"));
         initCommandBuffer();
     }
+    else if ( (command_done == 20) )
+    {
+        echo_io_batch_levels_in_json_rply();
+        initCommandBuffer();
+    }
     else
     {
         printf_P(PSTR("{\"err\":\"ioTogCmdDnWTF\"}\r\n"));
@@ -250,19 +292,24 @@ void Read(void)
 {
     if ( (command_done == 10) )
     {
-        // check that arg[0] is a digit 
-        if ( ( !( isdigit(arg[0][0]) ) ) )
+        // check that arg[0] is the AIN0..AIN7 enum value (or a batch of them)
+        if ( !typeArguments(is_arg_batch(0) ? pin_batch_schema : pin_schema, 1) )
         {
-            printf_P(PSTR("{\"err\":\"ioRdNaN\"}\r\n"));
+            if (arg_err == ARG_ERR_NAN)
+            {
+                printf_P(PSTR("{\"err\":\"ioRdNaN\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"err\":\"ioRdOutOfRng\"}\r\n"));
+            }
             initCommandBuffer();
             return;
         }
-        // and arg[0] value is the AIN0..AIN7 enum value
-        uint8_t a = atoi(arg[0]);
-        if ( (a < MCU_IO_AIN0) || (a > MCU_IO_AIN7) )
+        if (is_arg_batch(0))
         {
-            printf_P(PSTR("{\"err\":\"ioRdOutOfRng\"}\r\n"));
-            initCommandBuffer();
+            io_batch_mask = (uint8_t) arg_val[0].set;
+            command_done = 20;
             return;
         }
 
@@ -277,8 +324,7 @@ void Read(void)
     }
     else if ( (command_done == 12) )
     {
-        uint8_t a = atoi(arg[0]);
-        bool pin = ioRead( (MCU_IO_t) a);
+        bool pin = ioRead( (MCU_IO_t) arg_val[0].u32);
         if (pin)
         {
             printf_P(PSTR("HIGH"));
@@ -290,6 +336,11 @@ void Read(void)
         printf_P(PSTR("\"}\r\n"));
         initCommandBuffer();
     }
+    else if ( (command_done == 20) )
+    {
+        echo_io_batch_levels_in_json_rply();
+        initCommandBuffer();
+    }
     else
     {
         printf_P(PSTR("{\"err\":\"ioRdCmdDnWTF\"}\r\n"));
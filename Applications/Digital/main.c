@@ -26,6 +26,8 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 #include "../lib/rpu_mgr.h"
 #include "../lib/io_enum_bsd.h"
 #include "../Uart/id.h"
+#include "../Uart/mode.h"
+#include "../Uart/script.h"
 #include "digital.h"
 
 #define STATUS_LED CS0_EN
@@ -37,10 +39,35 @@ static char rpu_addr;
 
 void ProcessCmd()
 { 
+    if ( ScriptCapture() ) return; // the line after /script add is saved rather than run
     if ( (strcmp_P( command, PSTR("/id?")) == 0) && ( (arg_count == 0) || (arg_count == 1)) )
     {
         Id("Digital");
     }
+    if ( (strcmp_P( command, PSTR("/pipe?")) == 0) && (arg_count == 0) )
+    {
+        Pipe();
+    }
+    if ( (strcmp_P( command, PSTR("/pipe")) == 0) && (arg_count == 1) )
+    {
+        Pipe();
+    }
+    if ( (strcmp_P( command, PSTR("/echo?")) == 0) && (arg_count == 0) )
+    {
+        Echo();
+    }
+    if ( (strcmp_P( command, PSTR("/echo")) == 0) && (arg_count == 1) )
+    {
+        Echo();
+    }
+    if ( (strcmp_P( command, PSTR("/script?")) == 0) && (arg_count == 0) )
+    {
+        ScriptList();
+    }
+    if ( (strcmp_P( command, PSTR("/script")) == 0) && ( (arg_count == 1) || (arg_count == 2) ) )
+    {
+        Script();
+    }
     if ( (strcmp_P( command, PSTR("/iodir")) == 0) && ( (arg_count == 2 ) ) )
     {
         Direction();
@@ -77,6 +104,12 @@ void setup(void)
     /* Clear and setup the command buffer, (probably not needed at this point) */
     initCommandBuffer();
 
+    /* Echo and other command line modes are saved in EEPROM */
+    LoadModes();
+
+    /* a script saved in EEPROM can run the setup commands at power-up */
+    ScriptAutorun();
+
     // Enable global interrupts to start TIMER0 and UART ISR's
     sei(); 
     
@@ -115,11 +148,17 @@ int main(void)
         // use LED to show if I2C has a bus manager
         blink();
         
+        // a running script puts its next line in the command queue while the command line is idle
+        if ( is_command_idle() )
+        {
+            ScriptFeed(rpu_addr);
+        }
+
         // check if character is available to assemble a command, e.g. non-blocking
-        if ( (!command_done) && uart0_available() ) // command_done is an extern from parse.h
+        if ( (!command_done) && (CommandQueued() || uart0_available()) ) // command_done is an extern from parse.h
         {
-            // get a character from stdin and use it to assemble a command
-            AssembleCommand(getchar());
+            // get a character (pipelined input first, then stdin) and use it to assemble a command
+            AssembleCommand( CommandQueued() ? DequeueCommandInput() : getchar() );
 
             // address is an ascii value, warning: a null address would terminate the command string. 
             StartEchoWhenAddressed(rpu_addr);
@@ -130,9 +169,16 @@ int main(void)
         // the first byte is used as a warning, it is the onlly chance to detect a possible collision.
         if ( command_done && uart0_available() )
         {
-            // dump the transmit buffer to limit a collision 
-            uart0_flush(); 
-            initCommandBuffer();
+            if (command_pipeline)
+            { // the host is sending the next command line, hold it until this command is done
+                QueueCommandInput(getchar());
+            }
+            else
+            {
+                // dump the transmit buffer to limit a collision 
+                uart0_flush(); 
+                initCommandBuffer();
+            }
         }
         
         // finish echo of the command line befor starting a reply (or the next part of a reply)
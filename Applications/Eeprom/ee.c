@@ -37,30 +37,129 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 #include <ctype.h>
 #include <string.h>
 #include "../lib/parse.h"
+#include "../lib/json_bsd.h"
 #include "ee.h"
 
 static uint32_t ee_mem;
+static uint16_t ee_addr;
+static uint8_t ee_type;
 
-uint8_t ee_read_type(const char * addr, const char * type)
+// token index is the EE_TYPE_t value
+typedef enum EE_TYPE_enum
 {
-    if ( (type == NULL) || (strcmp_P(type, PSTR("UINT8")) ==0) )
+    EE_TYPE_UINT8,
+    EE_TYPE_UINT16,
+    EE_TYPE_UINT32
+} EE_TYPE_t;
+
+static const char ee_type_tokens[] PROGMEM = "UINT8\0UINT16\0UINT32\0";
+
+static const struct Arg_Schema ee_read_schema[] PROGMEM = {
+    {ARG_TYPE_UINT32, 0, (EEPROM_SIZE-1), NULL},
+    {ARG_TYPE_TOKEN, 0, 0, ee_type_tokens}
+};
+
+// a range of addresses, e.g., /0/ee? 0-31 or /0/ee? 32-63,UINT16
+static const struct Arg_Schema ee_range_schema[] PROGMEM = {
+    {ARG_TYPE_RANGE, 0, (EEPROM_SIZE-1), NULL},
+    {ARG_TYPE_TOKEN, 0, 0, ee_type_tokens}
+};
+
+// values in a range reply
+#define EE_RANGE_MAX 64
+static uint8_t ee_range_count;
+
+// bytes in each type
+static const uint8_t ee_type_size[] PROGMEM = {1, 2, 4};
+
+static const struct Arg_Schema ee_write_schema[] PROGMEM = {
+    {ARG_TYPE_UINT32, 0, (EEPROM_SIZE-1), NULL},
+    {ARG_TYPE_UINT32, 0, (int32_t)0xFFFFFFFFUL, NULL},
+    {ARG_TYPE_TOKEN, 0, 0, ee_type_tokens}
+};
+
+uint8_t ee_read_type(uint16_t addr, uint8_t type)
+{
+    if ( type == EE_TYPE_UINT8 )
     {
-        ee_mem = (uint32_t) eeprom_read_byte( (uint8_t*)(atoi(addr)) );
+        ee_mem = (uint32_t) eeprom_read_byte( (uint8_t*) addr );
         return 1;
     }
-    if ( strcmp_P(type, PSTR("UINT16")) == 0 )
+    if ( type == EE_TYPE_UINT16 )
     {
-        ee_mem =(uint32_t) eeprom_read_word((uint16_t*)(atoi(addr)));
+        ee_mem =(uint32_t) eeprom_read_word( (uint16_t*) addr );
         return 1;
     }
-    if ( strcmp_P(type, PSTR("UINT32")) == 0 )
+    if ( type == EE_TYPE_UINT32 )
     {
-        ee_mem =(uint32_t) eeprom_read_dword((uint32_t*)(atoi(addr)));
+        ee_mem =(uint32_t) eeprom_read_dword( (uint32_t*) addr );
         return 1;
     }
     return 0;
 }
 
+/* /0/ee? 0..1023-0..1023, [UINT8|UINT16|UINT32] gives {"EE[0]":["v0","v1",...]} */
+static void EEread_range(void)
+{
+    if ( (command_done == 10) )
+    {
+        // check that argument[0] is a range in 0..EEPROM_SIZE and argument[1] is UINT8|UINT16|UINT32
+        if ( !typeArguments(ee_range_schema, 2) )
+        {
+            if (arg_err_index == 1)
+            {
+                printf_P(PSTR("{\"err\":\"EeRdTypUINT8|16|32\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"err\":\"EeRdMaxAddr %d\"}\r\n"), EEPROM_SIZE);
+            }
+            initCommandBuffer();
+            return;
+        }
+        ee_addr = arg_val[0].range.lo;
+        ee_type = (arg_count == 2) ? arg_val[1].token : EE_TYPE_UINT8;
+        uint8_t size = pgm_read_byte(&ee_type_size[ee_type]);
+        uint16_t count = ((arg_val[0].range.hi - ee_addr) / size) + 1;
+        if ( ((ee_addr + (count * size)) > EEPROM_SIZE) || (count > EE_RANGE_MAX) )
+        {
+            printf_P(PSTR("{\"err\":\"EeRdRngMax %d\"}\r\n"), EE_RANGE_MAX);
+            initCommandBuffer();
+            return;
+        }
+        ee_range_count = (uint8_t) count;
+        json_start(JSON_QUOTE_NUMBERS);
+        command_done = 20;
+    }
+    else if ( (command_done == 20) )
+    {
+        uint8_t size = pgm_read_byte(&ee_type_size[ee_type]);
+        char key[10];
+        sprintf_P(key, PSTR("EE[%u]"), ee_addr);
+        json_pass();
+        json_obj_begin();
+        json_key(key);
+        json_arr_begin();
+        for (uint8_t i = 0; i < ee_range_count; i++)
+        {
+            // only read the value that goes out on this pass
+            ee_mem = 0;
+            if (json_pending()) ee_read_type(ee_addr + (i * size), ee_type);
+            json_uint(ee_mem);
+        }
+        json_arr_end();
+        json_obj_end();
+        json_eol();
+        if (json_blocked()) return; // next pass when the serial buffer has room
+        initCommandBuffer();
+    }
+    else
+    {
+        printf_P(PSTR("{\"err\":\"EeCmdDoneWTF\"}\r\n"));
+        initCommandBuffer();
+    }
+}
+
 /* /0/ee? 0..1023, [UINT8|UINT16|UINT32] */
 void EEread_cmd(void)
 {
@@ -71,43 +170,45 @@ void EEread_cmd(void)
         return;
     }
     
-    if ( (command_done == 10) )
+    // only a start-end address range is a batch here, all and a 0x mask of channels are not addresses
+    if ( arg_count && (strchr(arg[0], '-') != NULL) )
     {
-        // check that argument[0] is in the range 0..1023
-        if ( ( !( isdigit(arg[0][0]) ) ) || (atoi(arg[0]) < 0) || (atoi(arg[0]) >= EEPROM_SIZE) )
-        {
-            printf_P(PSTR("{\"err\":\"EeRdMaxAddr %d\"}\r\n"), EEPROM_SIZE);
-            initCommandBuffer();
-            return;
-        }
+        EEread_range();
+        return;
+    }
+    if (is_arg_batch(0))
+    {
+        printf_P(PSTR("{\"err\":\"EeRdRangeOnly\"}\r\n"));
+        initCommandBuffer();
+        return;
+    }
 
-        if ( arg_count == 1)
+    if ( (command_done == 10) )
+    {
+        // check that argument[0] is in the range 0..EEPROM_SIZE and argument[1] is UINT8|UINT16|UINT32
+        if ( !typeArguments(ee_read_schema, 2) )
         {
-            if (arg[1] != NULL)
+            if (arg_err_index == 1)
             {
-                printf_P(PSTR("{\"err\":\"ParserBroken\"}\r\n"));
-                initCommandBuffer();
-                return;
+                printf_P(PSTR("{\"err\":\"EeRdTypUINT8|16|32\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"err\":\"EeRdMaxAddr %d\"}\r\n"), EEPROM_SIZE);
             }
-        }
-
-       // check that argument[1] is UINT8|UINT16|UINT32
-        if ( ( arg_count == 2 ) && ( !( (strcmp_P(arg[1], PSTR("UINT8")) == 0) || \
-                                                    (strcmp_P(arg[1], PSTR("UINT16")) == 0) || \
-                                                    (strcmp_P(arg[1], PSTR("UINT32")) == 0) ) ) )
-        {
-            printf_P(PSTR("{\"err\":\"EeRdTypUINT8|16|32\"}\r\n"));
             initCommandBuffer();
             return;
         }
+        ee_addr = (uint16_t) arg_val[0].u32;
+        ee_type = (arg_count == 2) ? arg_val[1].token : EE_TYPE_UINT8;
         
-        printf_P(PSTR("{\"EE[%s]\":{"),arg[0]);
+        printf_P(PSTR("{\"EE[%u]\":{"),ee_addr);
         ee_mem = 0;
         command_done = 11;
     }
     else if ( (command_done == 11) )
     {  // I don't think there is much blocking during the EEPROM read.
-        if (!ee_read_type(arg[0], arg[1]))
+        if (!ee_read_type(ee_addr, ee_type))
         {
             printf_P(PSTR("\"err\":\"EeRdCmdDn11WTF\"}}\r\n"));
             initCommandBuffer();
@@ -132,44 +233,30 @@ void EEwrite_cmd(void)
 {
     if ( (command_done == 10) )
     {
-        // check that argument[0] is in the range 0..EEPROM_SIZE
-        if ( ( !( isdigit(arg[0][0]) ) ) || (atoi(arg[0]) < 0) || (atoi(arg[0]) >= EEPROM_SIZE) )
+        // check that argument[0] is in the range 0..EEPROM_SIZE, argument[1] is a number 
+        // (that will not overflow a uint32_t), and argument[2] is UINT8|UINT16|UINT32
+        if ( !typeArguments(ee_write_schema, 3) )
         {
-            printf_P(PSTR("{\"err\":\"EeAddrSize %d\"}\r\n"), EEPROM_SIZE);
-            initCommandBuffer();
-            return;
-        }
-        
-        // check that argument[1] is a number (it will not overflow a uint32_t)
-        if ( !( isdigit(arg[1][0]) ) )
-        {
-            printf_P(PSTR("{\"err\":\"EeData!=uint8_t\"}\r\n"));
-            initCommandBuffer();
-            return;
-        }
-        ee_mem = strtoul(arg[1], (char **)NULL, 10);
-
-        if ( arg_count == 2)
-        {
-            if (arg[2] != NULL)
+            if (arg_err_index == 2)
             {
-                printf_P(PSTR("{\"err\":\"ParserBroken\"}\r\n"));
-                initCommandBuffer();
-                return;
+                printf_P(PSTR("{\"err\":\"EeWrTypUINT8|16|32\"}\r\n"));
+            }
+            else if (arg_err_index == 1)
+            {
+                printf_P(PSTR("{\"err\":\"EeData!=uint8_t\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"err\":\"EeAddrSize %d\"}\r\n"), EEPROM_SIZE);
             }
-        }
-        
-       // check that argument[2] is UINT8|UINT16|UINT32
-        if ( ( arg_count == 3 ) && ( !( (strcmp_P(arg[2], PSTR("UINT8")) == 0) || \
-                                                    (strcmp_P(arg[2], PSTR("UINT16")) == 0) || \
-                                                    (strcmp_P(arg[2], PSTR("UINT32")) == 0) ) ) )
-        {
-            printf_P(PSTR("{\"err\":\"EeWrTypUINT8|16|32\"}\r\n"));
             initCommandBuffer();
             return;
         }
+        ee_addr = (uint16_t) arg_val[0].u32;
+        ee_mem = arg_val[1].u32;
+        ee_type = (arg_count == 3) ? arg_val[2].token : EE_TYPE_UINT8;
         
-        printf_P(PSTR("{\"EE[%d]\":{"), atoi(arg[0]));
+        printf_P(PSTR("{\"EE[%u]\":{"), ee_addr);
         command_done = 11;
     }
     else if ( (command_done == 11) )
@@ -178,22 +265,22 @@ void EEwrite_cmd(void)
         /*if ( eeprom_is_ready() ) 
         {
         */
-            if ( (arg[2] == NULL) || (strcmp_P(arg[2], PSTR("UINT8")) == 0) )
+            if ( ee_type == EE_TYPE_UINT8 )
             {
                 uint8_t value = (uint8_t) (ee_mem & 0xFFU);
                 printf_P(PSTR("\"byte\":\"%u\","),value);
-                eeprom_write_byte( (uint8_t *) (atoi(arg[0])), value);
+                eeprom_write_byte( (uint8_t *) ee_addr, value);
             }
-            if ( strcmp_P(arg[2], PSTR("UINT16")) == 0 )
+            if ( ee_type == EE_TYPE_UINT16 )
             {
                 uint16_t value = (uint16_t) (ee_mem & 0xFFFFU);
                 printf_P(PSTR("\"word\":\"%u\","),value);
-                eeprom_write_word( (uint16_t *) (atoi(arg[0])), value);
+                eeprom_write_word( (uint16_t *) ee_addr, value);
             }
-            if ( strcmp_P(arg[2], PSTR("UINT32")) == 0 )
+            if ( ee_type == EE_TYPE_UINT32 )
             {
                 printf_P(PSTR("\"dword\":\"%lu\","),ee_mem);
-                eeprom_write_dword( (uint32_t *) (atoi(arg[0])), ee_mem);
+                eeprom_write_dword( (uint32_t *) ee_addr, ee_mem);
             }
             command_done = 12;
         /*
@@ -202,7 +289,7 @@ void EEwrite_cmd(void)
     }
     else if ( (command_done == 12) )
     {
-        if (!ee_read_type(arg[0], arg[2]))
+        if (!ee_read_type(ee_addr, ee_type))
         {
             printf_P(PSTR("{\"err\":\"EeWrCmdDn12WTF\"}\r\n"));
             initCommandBuffer();
@@ -0,0 +1,127 @@
+/*
+bench times ../lib/parse.c on typical command lines
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES 
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF 
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, 
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, 
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+Each line is parsed and typed with the schema its command uses on the board, so a
+change to parse.c that breaks a line fails here before it is timed. The numbers are
+for the host, they are useful to compare one parse.c with another, not to predict
+the AVR (which has no cache and runs at 16MHz).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+#include "host.h"
+
+static const char digital_tokens[] = "LOW\0HIGH\0";
+static const char ee_tokens[] = "UINT8\0UINT16\0UINT32\0";
+static const char sub_tokens[] = "adc\0din\0";
+
+static const struct Arg_Schema no_args[] = { {ARG_TYPE_UINT32, 0, 0, NULL} };
+static const struct Arg_Schema adc_args[] = { {ARG_TYPE_SET, 0, 7, NULL} };
+static const struct Arg_Schema iowrt_args[] = { {ARG_TYPE_UINT32, 0, 31, NULL}, {ARG_TYPE_TOKEN, 0, 0, digital_tokens} };
+static const struct Arg_Schema ee_args[] = { {ARG_TYPE_RANGE, 0, 511, NULL}, {ARG_TYPE_TOKEN, 0, 0, ee_tokens} };
+static const struct Arg_Schema sub_args[] = {
+    {ARG_TYPE_TOKEN, 0, 0, sub_tokens}, {ARG_TYPE_SET, 0, 7, NULL}, {ARG_TYPE_UINT32, 10, 60000, NULL},
+    {ARG_TYPE_UINT32, 1, 4095, NULL}, {ARG_TYPE_UINT32, 1, 255, NULL}
+};
+
+struct Bench_Line {
+    const char *line;
+    const char *command; // what findCommand() should give
+    uint8_t args; // arguments it should find
+    const struct Arg_Schema *schema;
+    uint8_t schema_size;
+};
+
+static const struct Bench_Line lines[] = {
+    {"/0/id?\n", "/id?", 0, no_args, 1},
+    {"/0/adc? 0,1,2,3,4\n", "/adc?", 5, adc_args, 1},
+    {"/0/iowrt 3,HIGH\n", "/iowrt", 2, iowrt_args, 2},
+    {"/0/ee? 0-15,UINT16\n", "/ee?", 2, ee_args, 2},
+    {"/0/sub adc,0-7,100ms,4,50\n", "/sub", 5, sub_args, 5}
+};
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+static unsigned long long now_cycles(void)
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// parse one line, returns 0 if it did not give what the board expects
+static uint8_t parse_line(const struct Bench_Line *bl)
+{
+    if (!host_line((const uint8_t *)bl->line, strlen(bl->line), '0')) return 0;
+    if (strcmp(command, bl->command) || (arg_count != bl->args)) return 0;
+    if (strcmp(command, "/sub") == 0)
+    {
+        // as Adc/sub.c does, a period may be given with ms after the number
+        size_t len = strlen(arg[2]);
+        if ( (len > 2) && (strcmp(&arg[2][len-2], "ms") == 0) ) arg[2][len-2] = '\0';
+    }
+    if (arg_count && !typeArguments(bl->schema, bl->schema_size)) return 0;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long loops = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000UL;
+    uint8_t failed = 0;
+
+    printf("%-30s %12s %10s %10s\n", "line", "lines/sec", "ns/line", "cyc/line");
+    for (uint8_t i = 0; i < (sizeof lines / sizeof lines[0]); i++)
+    {
+        const struct Bench_Line *bl = &lines[i];
+        char shown[32];
+        snprintf(shown, sizeof shown, "%.*s", (int)strcspn(bl->line, "\r\n"), bl->line);
+        if (!parse_line(bl))
+        {
+            printf("%-30s did not parse as %s with %u arguments\n", shown, bl->command, bl->args);
+            failed = 1;
+            continue;
+        }
+
+        double start = now_sec();
+        unsigned long long cycles = now_cycles();
+        for (unsigned long n = 0; n < loops; n++)
+        {
+            parse_line(bl);
+        }
+        cycles = now_cycles() - cycles;
+        double sec = now_sec() - start;
+
+        printf("%-30s %12.0f %10.1f", shown, loops / sec, sec * 1.0e9 / loops);
+#ifdef HAVE_TSC
+        printf(" %10.1f\n", (double)cycles / loops);
+#else
+        printf(" %10s\n", "n/a");
+#endif
+    }
+    return failed;
+}
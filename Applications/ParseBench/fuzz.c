@@ -0,0 +1,198 @@
+/*
+fuzz feeds random command lines through ../lib/parse.c and checks that it stays inside its buffers
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES 
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF 
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, 
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, 
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+LLVMFuzzerTestOneInput is the libFuzzer entry (make fuzz, needs clang). It is also what
+AFL's llvm mode drives. Built with -DSTANDALONE it has a main() that runs the files given
+on the command line (e.g., an AFL queue), or a fixed-seed random run of -runs=N inputs when
+there are none (make check, gcc).
+Out of bounds access is found by the address sanitizer, the checks here are for the
+parser's own rules (argument pointers, counts, and typed values).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "check failed: %s (line %d)\n", #cond, __LINE__); abort(); } } while (0)
+
+static const char tokens[] = "LOW\0HIGH\0";
+
+static const struct Arg_Schema schemas[][2] = {
+    { {ARG_TYPE_UINT32, 0, 7, NULL}, {ARG_TYPE_TOKEN, 0, 0, tokens} },
+    { {ARG_TYPE_INT32, -1000, 1000, NULL}, {ARG_TYPE_INT32, (int32_t)0x80000000UL, 0x7FFFFFFFL, NULL} },
+    { {ARG_TYPE_RANGE, 0, 511, NULL}, {ARG_TYPE_UINT32, 0, (int32_t)0xFFFFFFFFUL, NULL} },
+    { {ARG_TYPE_SET, 0, 7, NULL}, {ARG_TYPE_SET, 3, 31, NULL} }
+};
+
+// an argument points inside command_buf after the command and is null terminated there
+static void check_arguments(void)
+{
+    CHECK(arg_count <= MAX_ARGUMENT_COUNT);
+    CHECK( (command >= command_buf) && (command < (command_buf + COMMAND_BUFFER_SIZE)) );
+    CHECK(memchr(command, '\0', (command_buf + COMMAND_BUFFER_SIZE) - command) != NULL);
+    for (uint8_t i = 0; i < arg_count; i++)
+    {
+        CHECK( (arg[i] > command) && (arg[i] < (command_buf + COMMAND_BUFFER_SIZE)) );
+        CHECK(memchr(arg[i], '\0', (command_buf + COMMAND_BUFFER_SIZE) - arg[i]) != NULL);
+    }
+}
+
+static void check_typed(const struct Arg_Schema *schema)
+{
+    if ( !typeArguments(schema, 2) )
+    {
+        CHECK(arg_err_index < arg_count);
+        CHECK(arg_err != ARG_ERR_NONE);
+        return;
+    }
+    for (uint8_t i = 0; i < arg_count; i++)
+    {
+        const struct Arg_Schema *entry = &schema[(i < 2) ? i : 1];
+        switch (entry->type)
+        {
+        case ARG_TYPE_UINT32:
+            CHECK( (arg_val[i].u32 >= (uint32_t)entry->min) && (arg_val[i].u32 <= (uint32_t)entry->max) );
+            break;
+        case ARG_TYPE_INT32:
+            CHECK( (arg_val[i].i32 >= entry->min) && (arg_val[i].i32 <= entry->max) );
+            break;
+        case ARG_TYPE_TOKEN:
+            CHECK(arg_val[i].token < 2);
+            break;
+        case ARG_TYPE_RANGE:
+            CHECK( (arg_val[i].range.lo <= arg_val[i].range.hi) && (arg_val[i].range.hi <= entry->max) );
+            break;
+        case ARG_TYPE_SET:
+        {
+            uint32_t allowed = (0xFFFFFFFFUL >> (31 - entry->max)) & (0xFFFFFFFFUL << entry->min);
+            CHECK( arg_val[i].set && !(arg_val[i].set & ~allowed) );
+            break;
+        }
+        }
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size < 1) return 0;
+
+    // first byte picks the modes
+    command_pipeline = data[0] & 0x01;
+    command_quiet = (data[0] >> 1) & 0x01;
+    EmptyCommandQueue();
+
+    if (host_line(data + 1, size - 1, '0') && (command_done == 10))
+    {
+        check_arguments();
+        for (uint8_t s = 0; s < (sizeof schemas / sizeof schemas[0]); s++)
+        {
+            check_typed(schemas[s]);
+            CHECK(is_arg_batch(arg_count) == 0);
+        }
+    }
+
+    // queued input comes back in order and the count goes down
+    uint8_t queued = CommandQueued();
+    CHECK(queued < COMMAND_QUEUE_SIZE);
+    while (CommandQueued())
+    {
+        CHECK(DequeueCommandInput() >= 0);
+        CHECK(CommandQueued() == --queued);
+    }
+    CHECK(DequeueCommandInput() == -1);
+    initCommandBuffer();
+    return 0;
+}
+
+#ifdef STANDALONE
+// pieces of real command lines make the random run reach past the first checks
+static const char *const dict[] = {
+    "/0/", "/1/", "id?", "adc?", "analog?", "iowrt", "ee?", "sub", " ", ",", "-", "0x", "all",
+    "0", "7", "255", "4294967295", "4294967296", "-2147483648", "HIGH", "LOW", "ms", "\r", "\n", "\b", "\x7F"
+};
+
+static size_t random_line(uint8_t *buf, size_t room)
+{
+    size_t len = 0;
+    buf[len++] = rand() & 0xFF;
+
+    // most lines start as a command to this address so the arguments get exercised
+    if (rand() % 4)
+    {
+        static const char *const starts[] = {"/0/id?", "/0/adc? ", "/0/iowrt ", "/0/ee? ", "/0/sub "};
+        const char *start = starts[rand() % (sizeof starts / sizeof starts[0])];
+        len += strlen(strcpy((char *)buf + len, start));
+    }
+    uint8_t pieces = rand() % 16;
+    for (uint8_t p = 0; p < pieces; p++)
+    {
+        if (rand() % 4)
+        {
+            const char *word = dict[rand() % (sizeof dict / sizeof dict[0])];
+            size_t n = strlen(word);
+            if (len + n > room) break;
+            memcpy(buf + len, word, n);
+            len += n;
+        }
+        else if (len < room)
+        {
+            buf[len++] = rand() & 0xFF;
+        }
+    }
+    if (len < room) buf[len++] = '\n';
+    return len;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long runs = 1000000UL;
+    if ( (argc > 1) && (strncmp(argv[1], "-runs=", 6) == 0) )
+    {
+        // same flag as libFuzzer
+        runs = strtoul(&argv[1][6], NULL, 0);
+        argc = 1;
+    }
+
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            FILE *f = fopen(argv[i], "rb");
+            if (!f)
+            {
+                perror(argv[i]);
+                return 1;
+            }
+            uint8_t buf[4096];
+            size_t n = fread(buf, 1, sizeof buf, f);
+            fclose(f);
+            LLVMFuzzerTestOneInput(buf, n);
+        }
+        printf("%d inputs ok\n", argc - 1);
+        return 0;
+    }
+
+    srand(26);
+    for (unsigned long r = 0; r < runs; r++)
+    {
+        uint8_t buf[80];
+        size_t n = random_line(buf, sizeof buf);
+        LLVMFuzzerTestOneInput(buf, n);
+    }
+    printf("%lu random inputs ok\n", runs);
+    return 0;
+}
+#endif
@@ -0,0 +1,78 @@
+/*
+host is the glue that lets ../lib/parse.c run on Linux for the fuzz and bench programs
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES 
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF 
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, 
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, 
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+parse.c is built with -include shim/host_io.h so its output is counted rather than
+written to the terminal.
+*/
+#include <stdarg.h>
+#include <stdio.h>
+#include "host.h"
+
+unsigned long host_out_bytes;
+
+int host_printf(const char *fmt, ...)
+{
+    char buf[128];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof buf, fmt, ap);
+    va_end(ap);
+    if (n > 0) host_out_bytes += n;
+    return n;
+}
+
+int host_putchar(int c)
+{
+    host_out_bytes++;
+    return c;
+}
+
+// the parts of the AVR main loop that use parse (see ../Adc/main.c)
+uint8_t host_line(const uint8_t *data, size_t size, char address)
+{
+    uint8_t found = 0;
+    initCommandBuffer();
+    for (size_t i = 0; i < size; i++)
+    {
+        if (!command_done)
+        {
+            AssembleCommand(data[i]);
+            StartEchoWhenAddressed(address);
+        }
+        else if (command_pipeline)
+        {
+            QueueCommandInput(data[i]);
+        }
+        else
+        {
+            initCommandBuffer(); // a byte while a command is in process ends it
+        }
+
+        if (command_done)
+        {
+            if (!echo_on)
+            {
+                initCommandBuffer();
+            }
+            else if (command_done == 1)
+            {
+                found = findCommand();
+                command_done = 10;
+            }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,15 @@
+#ifndef Host_H
+#define Host_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../lib/parse.h"
+
+// bytes that parse.c sent to the UART (they go to a counter, not the terminal)
+extern unsigned long host_out_bytes;
+
+// feed a command line through parse the way the main loops do, returns the findCommand() result
+extern uint8_t host_line(const uint8_t *data, size_t size, char address);
+
+#endif // Host_H 
@@ -0,0 +1,22 @@
+/* Host shim for avr/pgmspace.h so ../lib/parse.c builds natively.
+   Flash and RAM are the same memory on the host, the _P functions map to the plain ones.
+*/
+#ifndef PGMSPACE_SHIM_H
+#define PGMSPACE_SHIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+
+#define printf_P printf
+#define sprintf_P sprintf
+#define strcmp_P strcmp
+#define strlen_P strlen
+#define memcpy_P memcpy
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+#endif // PGMSPACE_SHIM_H
@@ -0,0 +1,119 @@
+/*
+mode is a library that sets how the command line is used (e.g., pipelined commands, echo).
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES 
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF 
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, 
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, 
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+Note the library files are LGPL, e.g., you need to publish changes of them but can derive from this 
+source and copyright or distribute as you see fit (it is Zero Clause BSD).
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+*/
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <stdlib.h> 
+#include "../lib/parse.h"
+#include "../lib/eerw_dx.h"
+#include "../lib/ee_map.h"
+#include "mode.h"
+
+static const char onoff_tokens[] PROGMEM = "OFF\0ON\0";
+
+static const struct Arg_Schema onoff_schema[] PROGMEM = {
+    {ARG_TYPE_TOKEN, 0, 0, onoff_tokens}
+};
+
+// /pipe? 
+// /pipe ON|OFF
+void Pipe(void)
+{ 
+    if (command_done == 10)
+    {
+        if (arg_count == 1)
+        {
+            if ( !typeArguments(onoff_schema, 1) )
+            {
+                printf_P(PSTR("{\"err\":\"PipeNaOnOff\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
+            command_pipeline = arg_val[0].token;
+            if (!command_pipeline) EmptyCommandQueue();
+        }
+        command_done = 11;
+    }
+    else if (command_done == 11)
+    {
+        if (command_pipeline)
+        {
+            printf_P(PSTR("{\"pipe\":\"ON\"}\r\n"));
+        }
+        else
+        {
+            printf_P(PSTR("{\"pipe\":\"OFF\"}\r\n"));
+        }
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+// load the modes that are saved in EEPROM, call it during setup
+void LoadModes(void)
+{
+    command_quiet = (eeprom_read_byte( (uint8_t *) EE_MODE_ECHO_ADDR) == EE_MODE_ECHO_OFF);
+}
+
+// /echo? 
+// /echo ON|OFF
+// with echo OFF the addressed command is not sent back, only its reply. The mode is saved in EEPROM.
+void Echo(void)
+{ 
+    if (command_done == 10)
+    {
+        if (arg_count == 1)
+        {
+            if ( !typeArguments(onoff_schema, 1) )
+            {
+                printf_P(PSTR("{\"err\":\"EchoNaOnOff\"}\r\n"));
+                initCommandBuffer();
+                return;
+            }
+            command_quiet = !arg_val[0].token;
+
+            // only write EEPROM when the mode changes, it is rated for 100k write cycles
+            uint8_t saved = eeprom_read_byte( (uint8_t *) EE_MODE_ECHO_ADDR);
+            if ( (saved == EE_MODE_ECHO_OFF) != command_quiet )
+            {
+                eeprom_write_byte( (uint8_t *) EE_MODE_ECHO_ADDR, command_quiet ? EE_MODE_ECHO_OFF : 0xFF);
+            }
+        }
+        command_done = 11;
+    }
+    else if (command_done == 11)
+    {
+        if (command_quiet)
+        {
+            printf_P(PSTR("{\"echo\":\"OFF\"}\r\n"));
+        }
+        else
+        {
+            printf_P(PSTR("{\"echo\":\"ON\"}\r\n"));
+        }
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
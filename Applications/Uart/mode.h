@@ -0,0 +1,8 @@
+#ifndef Mode_H
+#define Mode_H
+
+extern void Pipe(void);
+extern void Echo(void);
+extern void LoadModes(void);
+
+#endif // Mode_H 
@@ -0,0 +1,288 @@
+/*
+script is a library that keeps command lines in EEPROM and runs them (e.g., setup after power-up).
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES 
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF 
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE 
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY 
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, 
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, 
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+Note the library files are LGPL, e.g., you need to publish changes of them but can derive from this 
+source and copyright or distribute as you see fit (it is Zero Clause BSD).
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+A line is saved without its address (e.g., "iowrt 3,HIGH") and ends with a null, an
+erased byte (0xFF) after the last line ends the script. To run the script each line
+is put in the command queue with the node's address in front, so it goes through
+AssembleCommand and ProcessCmd like a line from the host. The next line is fed when
+the command line is idle, so its reply is done before the next line starts.
+*/
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include <stdio.h>
+#include <string.h>
+#include "../lib/parse.h"
+#include "../lib/uart0_bsd.h"
+#include "../lib/eerw_dx.h"
+#include "../lib/ee_map.h"
+#include "script.h"
+
+#define SCRIPT_END 0xFF
+
+static const char script_tokens[] PROGMEM = "add\0run\0clear\0auto\0";
+static const char onoff_tokens[] PROGMEM = "OFF\0ON\0";
+
+static const struct Arg_Schema script_schema[] PROGMEM = {
+    {ARG_TYPE_TOKEN, 0, 0, script_tokens},
+    {ARG_TYPE_TOKEN, 0, 0, onoff_tokens}
+};
+
+typedef enum SCRIPT_DO_enum
+{
+    SCRIPT_DO_ADD,
+    SCRIPT_DO_RUN,
+    SCRIPT_DO_CLEAR,
+    SCRIPT_DO_AUTO
+} SCRIPT_DO_t;
+
+static uint8_t script_capture; // the next line is saved rather than run
+static uint8_t script_running;
+static uint8_t script_at; // offset of the next line to run
+static uint8_t script_list_at; // offset of the next line to list
+
+// send a char of a saved line inside a JSON string, it is escaped as json_emit does so it can not end the string
+static void script_putc(char c)
+{
+    if ( (uint8_t)c < 0x20 )
+    {
+        printf_P(PSTR("\\u%04x"), (uint8_t)c); // e.g., a tab that was in the command line
+    }
+    else
+    {
+        if ( (c == '"') || (c == '\\') ) putchar('\\');
+        putchar(c);
+    }
+}
+
+static uint8_t script_read(uint8_t offset)
+{
+    return eeprom_read_byte( (uint8_t *) (EE_SCRIPT_ADDR + offset) );
+}
+
+// only write EEPROM bytes that change, it is rated for 100k write cycles
+static void script_write(uint8_t offset, uint8_t value)
+{
+    if (script_read(offset) != value)
+    {
+        eeprom_write_byte( (uint8_t *) (EE_SCRIPT_ADDR + offset), value);
+    }
+}
+
+// offset after the line at offset (or EE_SCRIPT_SIZE if it runs off the end)
+static uint8_t script_next(uint8_t offset)
+{
+    while ( (offset < EE_SCRIPT_SIZE) && script_read(offset) )
+    {
+        offset++;
+    }
+    return (offset < EE_SCRIPT_SIZE) ? (offset + 1) : EE_SCRIPT_SIZE;
+}
+
+// a line starts at offset
+static uint8_t script_has_line(uint8_t offset)
+{
+    return ( (offset < EE_SCRIPT_SIZE) && (script_read(offset) != SCRIPT_END) && script_read(offset) );
+}
+
+// offset of the end marker (where the next line is added)
+static uint8_t script_end(void)
+{
+    uint8_t offset = 0;
+    while ( script_has_line(offset) )
+    {
+        offset = script_next(offset);
+    }
+    return offset;
+}
+
+// /script add|run|clear
+// /script auto,ON|OFF
+// add saves the next command line to this address rather than running it.
+void Script(void)
+{ 
+    if (command_done == 10)
+    {
+        if ( !typeArguments(script_schema, 2) )
+        {
+            printf_P(PSTR("{\"err\":\"ScriptNaToken\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        uint8_t todo = arg_val[0].token;
+        if ( (todo == SCRIPT_DO_AUTO) != (arg_count == 2) )
+        {
+            printf_P(PSTR("{\"err\":\"ScriptArgCnt\"}\r\n"));
+            initCommandBuffer();
+            return;
+        }
+        switch (todo)
+        {
+        case SCRIPT_DO_ADD:
+            script_capture = 1;
+            printf_P(PSTR("{\"script\":\"add\"}\r\n"));
+            break;
+        case SCRIPT_DO_RUN:
+            // lines are fed after this reply is done
+            script_at = 0;
+            script_running = 1;
+            printf_P(PSTR("{\"script\":\"run\"}\r\n"));
+            break;
+        case SCRIPT_DO_CLEAR:
+            script_capture = 0;
+            script_running = 0;
+            script_write(0, SCRIPT_END);
+            printf_P(PSTR("{\"script\":\"clear\"}\r\n"));
+            break;
+        case SCRIPT_DO_AUTO:
+            if ( (eeprom_read_byte( (uint8_t *) EE_SCRIPT_AUTO_ADDR) == EE_SCRIPT_AUTO_ON) != arg_val[1].token )
+            {
+                eeprom_write_byte( (uint8_t *) EE_SCRIPT_AUTO_ADDR, arg_val[1].token ? EE_SCRIPT_AUTO_ON : 0xFF);
+            }
+            if (arg_val[1].token)
+            {
+                printf_P(PSTR("{\"auto\":\"ON\"}\r\n"));
+            }
+            else
+            {
+                printf_P(PSTR("{\"auto\":\"OFF\"}\r\n"));
+            }
+            break;
+        }
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+// /script? gives {"script":["iowrt 3,HIGH","sub adc,0-7,100ms"],"auto":"ON","free":"97"}
+// a line is sent each time the transmit buffer is empty
+void ScriptList(void)
+{ 
+    if (command_done == 10)
+    {
+        script_list_at = 0;
+        printf_P(PSTR("{\"script\":["));
+        command_done = 11;
+    }
+    else if (command_done == 11)
+    {
+        if ( script_has_line(script_list_at) )
+        {
+            if (script_list_at) putchar(',');
+            putchar('"');
+            for (uint8_t offset = script_list_at; (offset < EE_SCRIPT_SIZE) && script_read(offset); offset++)
+            {
+                script_putc( script_read(offset) );
+            }
+            putchar('"');
+            script_list_at = script_next(script_list_at);
+        }
+        else
+        {
+            command_done = 12;
+        }
+    }
+    else if (command_done == 12)
+    {
+        uint8_t end = script_end();
+        uint8_t free = (end < EE_SCRIPT_SIZE) ? (EE_SCRIPT_SIZE - 1 - end) : 0; // a line also needs its null
+        if (eeprom_read_byte( (uint8_t *) EE_SCRIPT_AUTO_ADDR) == EE_SCRIPT_AUTO_ON)
+        {
+            printf_P(PSTR("],\"auto\":\"ON\",\"free\":\"%d\"}\r\n"), free);
+        }
+        else
+        {
+            printf_P(PSTR("],\"auto\":\"OFF\",\"free\":\"%d\"}\r\n"), free);
+        }
+        initCommandBuffer();
+    }
+    else
+    {
+        initCommandBuffer();
+    }
+}
+
+// after /script add the next command line is saved, call it before the commands are dispatched.
+// Returns 1 when the line was taken. A /script line is not saved (it could run itself), it is dispatched.
+uint8_t ScriptCapture(void)
+{
+    if ( !script_capture || (command_done != 10) || (strncmp_P(command, PSTR("/script"), 7) == 0) ) return 0;
+    script_capture = 0;
+
+    // rebuild the line, findCommand() replaced the space and delimiters with nulls
+    char line[COMMAND_BUFFER_SIZE];
+    strcpy(line, command + 1);
+    for (uint8_t i = 0; i < arg_count; i++)
+    {
+        strcat_P(line, i ? PSTR(",") : PSTR(" "));
+        strcat(line, arg[i]);
+    }
+
+    // the line, its null, and an end marker (unless it fills the space exactly)
+    uint8_t offset = script_end();
+    uint8_t len = strlen(line);
+    if ( (offset + len + 1) > EE_SCRIPT_SIZE )
+    {
+        printf_P(PSTR("{\"err\":\"ScriptFull\"}\r\n"));
+        initCommandBuffer();
+        return 1;
+    }
+    for (uint8_t i = 0; i <= len; i++)
+    {
+        script_write(offset + i, line[i]);
+    }
+    if ( (offset + len + 1) < EE_SCRIPT_SIZE ) script_write(offset + len + 1, SCRIPT_END);
+    printf_P(PSTR("{\"add\":\""));
+    for (uint8_t i = 0; i < len; i++)
+    {
+        script_putc(line[i]);
+    }
+    printf_P(PSTR("\"}\r\n"));
+    initCommandBuffer();
+    return 1;
+}
+
+// run the script at power-up if auto is ON, call it during setup
+void ScriptAutorun(void)
+{
+    script_at = 0;
+    script_running = (eeprom_read_byte( (uint8_t *) EE_SCRIPT_AUTO_ADDR) == EE_SCRIPT_AUTO_ON);
+}
+
+// put the next line of a running script in the command queue, call it when the command line is idle
+void ScriptFeed(char address)
+{
+    if ( !script_running || uart0_available() ) return; // input from the host goes first
+    if ( !script_has_line(script_at) )
+    {
+        script_running = 0;
+        return;
+    }
+    QueueCommandInput('/');
+    QueueCommandInput(address);
+    QueueCommandInput('/');
+    for (; (script_at < EE_SCRIPT_SIZE) && script_read(script_at); script_at++)
+    {
+        QueueCommandInput( script_read(script_at) );
+    }
+    QueueCommandInput('\n');
+    script_at++; // past the null
+}
@@ -0,0 +1,10 @@
+#ifndef Script_H
+#define Script_H
+
+extern void Script(void);
+extern void ScriptList(void);
+extern uint8_t ScriptCapture(void);
+extern void ScriptAutorun(void);
+extern void ScriptFeed(char address);
+
+#endif // Script_H 
@@ -17,72 +17,482 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 */
 
 #include <util/atomic.h>
+#include <string.h>
 #include "adc_bsd.h"
 #include "references.h"
+#include "timers_bsd.h"
 
-volatile int adc[ADC_CHANNELS];
+volatile int32_t adc[ADC_CHANNELS];
 volatile ADC_CH_t adc_channel;
 volatile VREF_REFSEL_t analog_reference;
 volatile uint8_t adc_isr_status;
 
 static uint8_t free_running; // if true loop thru channels continuously
 uint8_t adc_auto_conversion;
+uint16_t adc_event_rate; // conversions per second for each channel when TCB2 events start them, zero otherwise
+static uint8_t res_shift; // decimation of the accumulated result for the channel in process
 
-// setup the ADC channel for reading
-void channel_setup(ADC_CH_t ch)
+uint8_t adc_scan_div[ADC_CHANNELS] = {1, 1, 1, 1, 1, 1, 1, 1};
+uint8_t adc_scan_plan[ADC_CHANNELS];
+uint8_t adc_scan_len;
+static uint8_t scan_at; // plan index of the channel in process
+static uint8_t scan_due; // channels converted in this burst
+static uint8_t scan_burst; // counts bursts for the divisors
+
+struct Adc_Snapshot adc_snap[2];
+volatile uint8_t adc_snap_front;
+
+struct Adc_Filter adc_filter[ADC_CHANNELS];
+volatile int32_t adc_filtered[ADC_CHANNELS];
+
+struct Adc_Alarm adc_alarm[ADC_CHANNELS];
+volatile uint8_t adc_alarm_latched;
+volatile uint8_t adc_alarm_new;
+
+uint8_t adc_capture[ADC_CAPTURE_SIZE];
+volatile uint8_t adc_capture_mask;
+uint8_t adc_capture_channels;
+uint8_t adc_capture_frame_size;
+uint16_t adc_capture_frames;
+volatile uint16_t adc_capture_head;
+volatile uint16_t adc_capture_count;
+volatile uint16_t adc_capture_left;
+
+struct Adc_Trig adc_trig;
+volatile uint8_t adc_trig_state;
+static int32_t trig_last; // reading of the trigger channel at the last frame, for the edges
+
+struct Adc_Stats adc_stats[2];
+volatile uint8_t adc_stats_live;
+volatile uint8_t adc_stat_mask;
+unsigned long adc_stat_window;
+
+// widest reading an accumulation can give, more than 16 twelve bit samples do not fit in RES
+// so the ADC drops the low bits (ACC32 by 1, ACC64 by 2, ACC128 by 3) and the result is 16 bits
+uint8_t adc_acc_bits_max(ADC_SAMPNUM_t sampnum)
+{
+    uint8_t bits = ADC_BITS + sampnum; // sampnum is log2 of the samples
+    return (bits > ADC_BITS_MAX) ? ADC_BITS_MAX : bits;
+}
+
+// registers as channel_setup last wrote them, so a channel change only writes what differs
+static uint8_t setup_valid; // cleared when the ADC needs a full init (e.g., at startup)
+static VREF_REFSEL_t setup_adc0ref;
+static ADC_MUXNEG_t setup_muxneg;
+static uint8_t setup_convmode; // CONVMODE is changed with a full init, as the reference is
+static uint8_t setup_sampctrl;
+static ADC_SAMPNUM_t setup_sampnum;
+static ADC_WINCM_t setup_wincm; // CTRLE keeps its value when the ADC is disabled
+
+// full init, the ADC is stopped and disabled so the reference can change, and it waits INITDLY when enabled
+static void channel_init(ADC_CH_t ch)
 {
     ADC0.COMMAND = ADC_SPCONV_bm;                 // Stop ADC conversion to get a clean value
     ADC0.CTRLA  = 0;                              // disabled
-    adc_channel = ch;
-    VREF.ADC0REF = adcConfMap[ch].adc0ref;        // after each reading the referance will disconnect
-    ADC0.CTRLA = ADC_RESSEL_12BIT_gc;             // 12-bit mode
-    //ADC0.CTRLA |= ADC_CONVMODE_bm;                // DIFFERENTIAL mode
-#if F_CPU >= 24000000
-    ADC0.CTRLC = ADC_PRESC_DIV24_gc;              // 1 MHz DS datasheet ADC clock to be faster than 150 kHz.
-#elif F_CPU >= 20000000
-    ADC0.CTRLC = ADC_PRESC_DIV20_gc;              // 1 MHz
-#elif F_CPU >= 16000000
-    ADC0.CTRLC = ADC_PRESC_DIV16_gc;              // 1 MHz
-#elif F_CPU >= 12000000
-    ADC0.CTRLC = ADC_PRESC_DIV12_gc;              // 1 MHz
-#elif F_CPU >= 8000000
-    ADC0.CTRLC = ADC_PRESC_DIV8_gc;               // 1 MHz
-#elif F_CPU >= 4000000
-    ADC0.CTRLC = ADC_PRESC_DIV4_gc;               // 1 MHz
-#else  
-    ADC0.CTRLC = ADC_PRESC_DIV2_gc;              // the lowest setting
-#endif
+    VREF.ADC0REF = adcConfMap[ch].adc0ref;        // the referance is requested while the ADC is enabled
+    ADC0.CTRLA = ADC_RESSEL_12BIT_gc | adcConfMap[ch].convmode; // 12-bit mode, single ended or differential
+    ADC0.CTRLB = adcConfMap[ch].sampnum;          // samples accumulated in hardware for one result
+    ADC0.CTRLC = ADC_PRESC;                       // 1 MHz DS datasheet ADC clock to be faster than 150 kHz.
     ADC0.MUXPOS = adcConfMap[ch].muxpos;          // select +ADC side
     ADC0.MUXNEG = adcConfMap[ch].muxneg;          // select -ADC side
     ADC0.SAMPCTRL = adcConfMap[ch].sampctrl;      // extend the ADC sampling time beyond the default two clocks
     ADC0.CTRLD = ADC_INITDLY_DLY16_gc;            // the reference may need some time to stabalize.
     ADC0.CTRLA |= ADC_ENABLE_bm;                  // ADC Enabled
+
+    setup_adc0ref = adcConfMap[ch].adc0ref;
+    setup_muxneg = adcConfMap[ch].muxneg;
+    setup_convmode = adcConfMap[ch].convmode;
+    setup_sampctrl = adcConfMap[ch].sampctrl;
+    setup_sampnum = adcConfMap[ch].sampnum;
+    setup_valid = 1;
+}
+
+// setup the ADC channel for reading. 
+// The ADC is idle when this is called (the last result was read), so if the reference is the same 
+// it stays enabled and only the registers that differ are written, e.g., MUXPOS in a scan of AIN0..AIN7.
+static void channel_select(ADC_CH_t ch)
+{
+    adc_channel = ch;
+    if ( !setup_valid || (adcConfMap[ch].adc0ref != setup_adc0ref) || (adcConfMap[ch].convmode != setup_convmode) )
+    {
+        channel_init(ch);
+    }
+    else
+    {
+        ADC0.MUXPOS = adcConfMap[ch].muxpos;      // select +ADC side
+        if (adcConfMap[ch].muxneg != setup_muxneg)
+        {
+            ADC0.MUXNEG = setup_muxneg = adcConfMap[ch].muxneg;
+        }
+        if (adcConfMap[ch].sampctrl != setup_sampctrl)
+        {
+            ADC0.SAMPCTRL = setup_sampctrl = adcConfMap[ch].sampctrl;
+        }
+        if (adcConfMap[ch].sampnum != setup_sampnum)
+        {
+            ADC0.CTRLB = setup_sampnum = adcConfMap[ch].sampnum;
+        }
+    }
+    uint8_t acc_bits = adc_acc_bits_max(adcConfMap[ch].sampnum);
+    res_shift = (adcConfMap[ch].bits < acc_bits) ? (acc_bits - adcConfMap[ch].bits) : 0; // decimate to the channel width
+
+    // the window compares RES, so the levels are moved up to the accumulated result
+    if (adc_alarm[ch].mode || setup_wincm)
+    {
+        uint32_t lo = (uint32_t) adc_alarm[ch].lo << res_shift;
+        uint32_t hi = ( (uint32_t) adc_alarm[ch].hi << res_shift) | ( (1U << res_shift) - 1); // over hi after decimation
+        ADC0.WINLT = (lo > 0xFFFF) ? 0xFFFF : lo;
+        ADC0.WINHT = (hi > 0xFFFF) ? 0xFFFF : hi;
+        ADC0.CTRLE = setup_wincm = adc_alarm[ch].mode;
+    }
+}
+
+// median of three or five readings
+static int32_t median(int32_t *hist, uint8_t n)
+{
+    int32_t v[5];
+    for (uint8_t i = 0; i < n; i++)
+    {
+        // insertion sort, it is only a few readings
+        int32_t x = hist[i];
+        uint8_t j = i;
+        for (; j && (v[j-1] > x); j--)
+        {
+            v[j] = v[j-1];
+        }
+        v[j] = x;
+    }
+    return v[n >> 1];
+}
+
+// next filtered value of a channel from its reading
+static int32_t filter_step(struct Adc_Filter *f, int32_t x)
+{
+    if (f->kind == ADC_FILTER_EMA)
+    {
+        if (!f->primed)
+        {
+            f->sum = x << f->n;
+            f->primed = 1;
+        }
+        else
+        {
+            f->sum += x - (f->sum >> f->n);
+        }
+        return (f->sum + (1L << (f->n - 1))) >> f->n;
+    }
+
+    uint8_t size = (f->kind == ADC_FILTER_BOX) ? (1 << f->n) : f->n;
+    if (!f->primed)
+    { // the first reading fills the history, so the average does not need a divide while it fills
+        for (uint8_t i = 0; i < size; i++)
+        {
+            f->hist[i] = x;
+        }
+        f->sum = x << f->n;
+        f->at = 0;
+        f->primed = 1;
+    }
+    if (f->kind == ADC_FILTER_BOX)
+    {
+        f->sum += x - f->hist[f->at];
+        f->hist[f->at] = x;
+        f->at = (f->at + 1) & (size - 1);
+        return (f->sum + (1L << (f->n - 1))) >> f->n;
+    }
+    f->hist[f->at] = x;
+    if (++f->at >= size) f->at = 0;
+    return median(f->hist, size);
+}
+
+// result of the conversion that is done, a differential result is signed (reading RES clears the interrupt flag)
+static inline int32_t adc_result(void)
+{
+    if (setup_convmode) return (int16_t) ADC0.RES >> res_shift;
+    return ADC0.RES >> res_shift;
+}
+
+// true (and the flag is cleared) when the window comparator hit on the result that was just read
+static uint8_t alarm_hit(void)
+{
+    if ( !(ADC0.INTFLAGS & ADC_WCMP_bm) ) return 0;
+    ADC0.INTFLAGS = ADC_WCMP_bm; // clear
+    return 1;
+}
+
+// latch an alarm for a channel that hit its window
+static void alarm_latch(ADC_CH_t ch, int32_t value)
+{
+    uint8_t bit = (1 << ch);
+    if ( !(adc_alarm_latched & bit) )
+    {
+        adc_alarm[ch].stamp = ticksFine();
+        adc_alarm[ch].value = value;
+        adc_alarm_latched |= bit;
+        adc_alarm_new |= bit;
+    }
+}
+
+// setup the ADC channel for reading and start a conversion
+void channel_setup(ADC_CH_t ch)
+{
+    channel_select(ch);
     ADC0.COMMAND = ADC_STCONV_bm;                 // Start ADC conversion
 }
 
 
-// The conversion result is available in ADC0.RES.
-ISR(ADC0_RESRDY_vect) 
+// add a reading to the statistics of its channel
+static void stat_step(struct Adc_Stat *st, int32_t x)
 {
-    adc[adc_channel] = ADC0.RES;        // Clear the interrupt flag by reading the result
+    if (!st->n)
+    {
+        st->first = st->min = st->max = x;
+    }
+    else if (st->n >= ADC_STAT_COUNT_MAX)
+    {
+        return;
+    }
+    if (x < st->min) st->min = x;
+    if (x > st->max) st->max = x;
+    int32_t d = x - st->first;
+    uint16_t m = (d < 0) ? -d : d; // a spread of 16 bit readings fits
+    st->sum += d;
+    st->sumsq += (uint32_t) m * m;
+    st->n++;
+}
 
-    if (adc_channel >= ADC_CH_ADC7) 
+// clear the set that is not live and start adding to it, the set that was live is then finished.
+// Called from the ISR, or by the reader when the ISR does not flip (no window).
+static void stats_flip(unsigned long now)
+{
+    uint8_t next = adc_stats_live ^ 1;
+    memset(adc_stats[next].ch, 0, sizeof(adc_stats[next].ch));
+    adc_stats[next].start = now;
+    adc_stats[adc_stats_live].end = now;
+    adc_stats_live = next; // one byte so the flip is atomic
+}
+
+// the trigger condition for the reading of the trigger channel at this frame
+static uint8_t trig_check(void)
+{
+    int32_t value = adc[adc_trig.ch];
+    int32_t last = trig_last;
+    trig_last = value;
+    switch (adc_trig.mode)
     {
-        adc_channel = ADC_CH_ADC0;
+        case ADC_TRIG_ABOVE:
+            return (value >= adc_trig.lo);
+        case ADC_TRIG_BELOW:
+            return (value <= adc_trig.lo);
+        case ADC_TRIG_RISE:
+            return ( (last < adc_trig.lo) && (value >= adc_trig.lo) );
+        case ADC_TRIG_FALL:
+            return ( (last > adc_trig.lo) && (value <= adc_trig.lo) );
+        case ADC_TRIG_INSIDE:
+            return ( (value >= adc_trig.lo) && (value <= adc_trig.hi) );
+        default:
+            return ( (value < adc_trig.lo) || (value > adc_trig.hi) );
     }
-    else
+}
+
+// put a frame of the scan that is done in the capture ring
+static void capture_frame(void)
+{
+    uint8_t *at = &adc_capture[adc_capture_head * adc_capture_frame_size];
+    unsigned long stamp = ticksFine();
+    unsigned long frame_stamp = stamp;
+    for (uint8_t i = 0; i < ADC_CAPTURE_STAMP; i++)
+    {
+        *at++ = (uint8_t) stamp;
+        stamp >>= 8;
+    }
+    uint8_t odd = 0;
+    for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+    {
+        if ( !(adc_capture_mask & (1<<ch)) ) continue;
+        uint16_t value = (uint16_t)(adc[ch] >> (adcConfMap[ch].bits - ADC_BITS));
+        if (!odd)
+        {
+            *at++ = (uint8_t) value;
+            *at = (value >> 8) & 0x0F; // the next reading fills the high nibble
+        }
+        else
+        {
+            *at++ |= (uint8_t)(value << 4);
+            *at++ = (uint8_t)(value >> 4);
+        }
+        odd ^= 1;
+    }
+
+    if (++adc_capture_head >= adc_capture_frames) adc_capture_head = 0;
+    if (adc_capture_count < adc_capture_frames) adc_capture_count++;
+
+    if ( (adc_trig_state == ADC_TRIG_PRE) || (adc_trig_state == ADC_TRIG_ARMED) )
+    {
+        uint8_t hit = trig_check(); // always run so the edges have the last reading
+        if ( (adc_trig_state == ADC_TRIG_PRE) && (adc_capture_count > adc_trig.pre) ) adc_trig_state = ADC_TRIG_ARMED;
+        if ( (adc_trig_state == ADC_TRIG_ARMED) && hit )
+        {
+            // keep the pre frames and the trigger frame, older ones are not part of the capture
+            adc_capture_count = adc_trig.pre + 1;
+            adc_capture_left = adc_trig.post;
+            adc_trig.stamp = frame_stamp;
+            adc_trig_state = ADC_TRIG_POST;
+            if (!adc_capture_left)
+            {
+                adc_capture_mask = 0;
+                adc_trig_state = ADC_TRIG_DONE;
+            }
+        }
+    }
+    else if (adc_capture_left && !(--adc_capture_left)) // the frames asked for are in
+    {
+        adc_capture_mask = 0;
+        if (adc_trig_state == ADC_TRIG_POST) adc_trig_state = ADC_TRIG_DONE;
+    }
+}
+
+// plan index of the first channel due in this burst at or after at, adc_scan_len if there is none
+static uint8_t scan_next(uint8_t at)
+{
+    while ( (at < adc_scan_len) && !(scan_due & (1 << adc_scan_plan[at])) ) at++;
+    return at;
+}
+
+// Find the channels due in this burst and start at the first of them in the plan. The main loop bursts test the 
+// burst they are on, one with no channel due (each has a divisor) converts nothing. Events and free running 
+// (skip is set) do not wait for those, they jump to the next burst the fastest channel in the plan is due on, 
+// the divisors are powers of two so that is a round up. Returns 0 if no channel is converted.
+static uint8_t scan_start(uint8_t skip)
+{
+    scan_due = 0;
+    if (!adc_scan_len) return 0;
+    if (skip)
+    {
+        uint8_t fastest = 128;
+        for (uint8_t i = 0; i < adc_scan_len; i++)
+        {
+            uint8_t div = adc_scan_div[adc_scan_plan[i]];
+            if (div < fastest) fastest = div;
+        }
+        scan_burst = (scan_burst + fastest - 1) & ~(fastest - 1);
+    }
+    for (uint8_t i = 0; i < adc_scan_len; i++)
+    {
+        uint8_t ch = adc_scan_plan[i];
+        if ( !(scan_burst & (adc_scan_div[ch] - 1)) ) scan_due |= (1 << ch);
+    }
+    scan_burst++;
+    if (!scan_due) return 0;
+    scan_at = scan_next(0);
+    return 1;
+}
+
+// Order the scan so channels on the same reference (and conversion mode) are next to each other, 
+// channel_select() only does the full init with its INITDLY settling when those change, so a scan 
+// has one per group instead of one per switch. Channels with a divisor of zero are not in the plan. 
+// Call it when a reference, mux or divisor changes.
+void adc_scan_plan_build(void)
+{
+    uint8_t plan[ADC_CHANNELS];
+    uint8_t len = 0;
+    for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
     {
-        ++adc_channel;
+        if (!adc_scan_div[ch]) continue;
+        uint16_t key = (adcConfMap[ch].adc0ref << 8) | adcConfMap[ch].convmode;
+        uint8_t at = len++;
+        // insertion sort that keeps channel order in a group
+        while ( at && ( ( (adcConfMap[plan[at-1]].adc0ref << 8) | adcConfMap[plan[at-1]].convmode ) > key) )
+        {
+            plan[at] = plan[at-1];
+            at--;
+        }
+        plan[at] = ch;
     }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (uint8_t i = 0; i < len; i++) adc_scan_plan[i] = plan[i];
+        adc_scan_len = len; // a burst in process ends early if it was past the new length
+    }
+}
 
-    if (adc_channel)
+// set the divisor of the channels in mask and rebuild the plan, the ISR does not see the divisors without the plan
+void adc_scan_set(uint8_t mask, uint8_t div)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        channel_setup(adc_channel);
+        for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+        {
+            if (mask & (1 << ch)) adc_scan_div[ch] = div;
+        }
+        adc_scan_plan_build();
     }
-    else if (free_running) // do not confuse with Bit 1 of ADC0.CTRLA which would loop on the same channel
+}
+
+#ifdef ADC_ISR_PROBE
+volatile uint16_t adc_isr_selected;
+#define ADC_ISR_SELECTED() adc_isr_selected = TCB1.CNT
+#else
+#define ADC_ISR_SELECTED()
+#endif
+
+// The conversion result is available in ADC0.RES.
+// With events the next event may come as soon as the ADC is done, so the mux for the next channel is set first 
+// and the rest (filter, statistics, snapshot, capture) runs while that channel converts.
+// The benchmark (../Adc_MC) builds this with ADC_ISR_PROBE and calls it from its own ISR to time it.
+#ifdef ADC_ISR_PROBE
+void adc_isr(void)
+#else
+ISR(ADC0_RESRDY_vect) 
+#endif
+{
+    int32_t reading = adc_result();                 // Clear the interrupt flag by reading the result, keep the full width
+    ADC_CH_t ch = adc_channel;                      // channel_select changes it to the next channel
+    uint8_t hit = alarm_hit();
+    uint8_t done_due = scan_due;                    // scan_start changes it to the next burst
+    scan_at = scan_next(scan_at + 1);
+    uint8_t burst_done = (scan_at >= adc_scan_len);
+    uint8_t more = !burst_done;                     // a channel is converted next
+    if ( burst_done && (adc_event_rate || free_running) ) more = scan_start(1);
+    if (adc_event_rate && more) channel_select( (ADC_CH_t) adc_scan_plan[scan_at]);
+    ADC_ISR_SELECTED();
+
+    adc[ch] = reading;
+    int32_t filtered = adc_filter[ch].kind ? filter_step(&adc_filter[ch], reading) : reading;
+    adc_filtered[ch] = filtered;
+    if (hit) alarm_latch(ch, reading);
+    struct Adc_Snapshot *back = &adc_snap[adc_snap_front ^ 1];
+    back->adc[ch] = reading;
+    back->filtered[ch] = filtered;
+    if (adc_stat_mask & (1 << ch)) stat_step(&adc_stats[adc_stats_live].ch[ch], reading);
+
+    if (burst_done) 
     {
-        channel_setup(adc_channel);
-        adc_isr_status = ISR_ADCBURST_START;
+        struct Adc_Snapshot *front = &adc_snap[adc_snap_front];
+        for (uint8_t i = ADC_CH_ADC0; i < ADC_CHANNELS; i++)
+        {
+            if (done_due & (1 << i)) continue;
+            back->adc[i] = front->adc[i]; // a channel that was not due keeps its last reading
+            back->filtered[i] = front->filtered[i];
+        }
+        back->seq = front->seq + 1;
+        adc_snap_front ^= 1; // the burst is done, readers now copy it
+        if (adc_capture_mask) capture_frame();
+        if (adc_stat_mask && adc_stat_window)
+        {
+            unsigned long now = ticksFine();
+            if ( (now - adc_stats[adc_stats_live].start) >= adc_stat_window ) stats_flip(now);
+        }
+    }
+
+    if (adc_event_rate)
+    { // the next event starts the conversion of the channel selected above
+        adc_isr_status = burst_done ? ISR_ADCBURST_DONE : ISR_ADCBURST_START;
+    }
+    else if (more)
+    {
+        channel_setup( (ADC_CH_t) adc_scan_plan[scan_at]);
+        if (burst_done) adc_isr_status = ISR_ADCBURST_START; // free running
     }
     else
     {
@@ -97,6 +507,7 @@ ISR(ADC0_RESRDY_vect)
 void init_ADC_single_conversion(void)
 {
     free_running = 0;
+    setup_valid = 0; // the first channel_setup does a full init
 
     // load references or set error
     ref_loaded = VREF_LOADED_NO;
@@ -119,33 +530,276 @@ void init_ADC_single_conversion(void)
 // in a buffer.
 void enable_ADC_auto_conversion(uint8_t free_run)
 {
+    if (adc_event_rate) disable_ADC_event_conversion();
+    if (!scan_start(free_run))
+    { // no channel is due in this burst
+        adc_isr_status = ISR_ADCBURST_DONE;
+        return;
+    }
     adc_isr_status = ISR_ADCBURST_START; // mark so we know new readings are wip
     free_running = free_run;
     adc_auto_conversion = 1;
 
-    // Start the first Conversion and touch the interupt bit
-    channel_setup(ADC_CH_ADC0);
+    // Start the first Conversion (of the scan plan) and touch the interupt bit
+    channel_setup( (ADC_CH_t) adc_scan_plan[scan_at]);
     ADC0.INTCTRL = ADC_RESRDY_bm;                      // Enable interrupts
 }
 
-// return two byes from the last ADC update with an atomic transaction to make sure ISR does not change it durring the read
-int adcAtomic(ADC_CH_t channel)
+// Fewest CPU clocks between start events so each conversion of the plan is done, and the ISR has selected the 
+// next channel, before the next event. A result takes SAMPCTRL + ADC_SAMPLE_CLKS + ADC_CONV_CLKS ADC clocks for 
+// each accumulated sample, and a channel that changes the reference (or conversion mode) group also waits INITDLY. 
+// The ISR has to keep up over a burst, and the long one at the end of a burst must still select the channel 
+// after it before the event after that.
+uint32_t adc_event_period_min(void)
+{
+    uint32_t most = 0;
+    for (uint8_t i = 0; i < adc_scan_len; i++)
+    {
+        uint8_t ch = adc_scan_plan[i];
+        uint8_t prev = adc_scan_plan[i ? (i - 1) : (adc_scan_len - 1)]; // the plan wraps
+        uint32_t clks = ( (uint32_t)adcConfMap[ch].sampctrl + ADC_SAMPLE_CLKS + ADC_CONV_CLKS ) << adcConfMap[ch].sampnum;
+        if ( (adcConfMap[ch].adc0ref != adcConfMap[prev].adc0ref) || (adcConfMap[ch].convmode != adcConfMap[prev].convmode) )
+        {
+            clks += ADC_INITDLY_CLKS;
+        }
+        if (clks > most) most = clks;
+    }
+    uint32_t conv = most * ADC_PRESC_DIV;
+    uint32_t period = conv + ADC_ISR_SELECT_CLKS;
+    if (!adc_scan_len) return period;
+    uint32_t keep_up = ( ( (uint32_t)(adc_scan_len - 1) * ADC_ISR_CH_CLKS ) + ADC_ISR_BURST_CLKS + adc_scan_len - 1 ) / adc_scan_len;
+    if (keep_up > period) period = keep_up;
+    uint32_t after_burst = (conv + ADC_ISR_BURST_CLKS + ADC_ISR_SELECT_CLKS + 1) / 2;
+    if (after_burst > period) period = after_burst;
+    return period;
+}
+
+// After a setting that changes the conversion time (e.g., accumulation, sample time, the plan) the event period is 
+// worked out again. Returns 0 if events are running and the rate can no longer be made, they are left as they were.
+uint8_t adc_event_retime(void)
+{
+    if (!adc_event_rate) return 1;
+    return enable_ADC_event_conversion(adc_event_rate);
+}
+
+// Conversions started by an event at a fixed rate, so the sample time does not move with the main loop load. 
+// TCB2 in periodic interrupt mode makes a capture event each period (its interrupt is not used), event 
+// channel 2 takes it to the ADC start input, and the ISR takes the result and sets the mux for the 
+// next channel before anything else. The rate is for each channel in the scan plan, the events are adc_scan_len times faster 
+// (a channel with a divisor is skipped on most bursts so the others get its events). 
+// TCB2 counts CLK_PER, CLK_PER/2, or for slow rates CLK_TCA, so a plan of any length can go down to ADC_EVENT_RATE_MIN. 
+// Returns 0 if the rate can not be made with TCB2 (e.g., 16 to 4000 Hz at 16MHz), an event would come before 
+// the conversion of a channel is done (see adc_event_period_min), or no channel is scanned.
+uint8_t enable_ADC_event_conversion(uint16_t ch_rate_hz)
+{
+    if ( (ch_rate_hz < ADC_EVENT_RATE_MIN) || (ch_rate_hz > ADC_EVENT_RATE_MAX) || !adc_scan_len ) return 0;
+    uint32_t top = F_CPU / ( (uint32_t)ch_rate_hz * adc_scan_len );
+    if (top < adc_event_period_min()) return 0; // a start event while the ADC is busy would be lost
+    TCB_CLKSEL_t clksel = TCB_CLKSEL_DIV1_gc;
+    if (top > 0x20000UL)
+    { // below about 123 events a second at 16MHz, CLK_TCA (the ticksFine count from initTimers) is slow enough
+        top = (F_CPU / TICK_FINE_CLOCKS) / ( (uint32_t)ch_rate_hz * adc_scan_len );
+        clksel = TCB_CLKSEL_TCA0_gc;
+    }
+    else if (top > 0x10000UL)
+    {
+        top /= 2;
+        clksel = TCB_CLKSEL_DIV2_gc;
+    }
+    if (top > 0x10000UL) return 0;
+
+    uint8_t oldSREG = SREG;
+    cli();
+    TCB2.CTRLA = 0;
+    ADC0.INTCTRL = 0;
+    ADC0.COMMAND = ADC_SPCONV_bm;                 // stop a burst that is in process
+    adc_event_rate = ch_rate_hz;
+    free_running = 0;
+    adc_auto_conversion = 1;                      // single conversions would corrupt the scan
+    adc_isr_status = ISR_ADCBURST_START;
+    setup_valid = 0;
+    scan_start(1);
+    channel_select( (ADC_CH_t) adc_scan_plan[scan_at]); // the first event converts the first channel of the plan
+    EVSYS.CHANNEL2 = EVSYS_CHANNEL2_TCB2_CAPT_gc;
+    EVSYS.USERADC0START = EVSYS_USER_CHANNEL2_gc;
+    ADC0.EVCTRL = ADC_STARTEI_bm;                 // an event starts a conversion
+    ADC0.INTCTRL = ADC_RESRDY_bm;
+    TCB2.CCMP = (uint16_t)(top - 1);
+    TCB2.CNT = 0;
+    TCB2.CTRLB = TCB_CNTMODE_INT_gc;
+    TCB2.CTRLA = clksel | TCB_ENABLE_bm;
+    SREG = oldSREG;
+    return 1;
+}
+
+// stop the event conversions, e.g., to go back to bursts
+void disable_ADC_event_conversion(void)
+{
+    uint8_t oldSREG = SREG;
+    cli();
+    TCB2.CTRLA = 0;
+    ADC0.EVCTRL = 0;
+    EVSYS.USERADC0START = 0;
+    ADC0.INTCTRL = 0;
+    adc_event_rate = 0;
+    adc_auto_conversion = 0;
+    adc_isr_status = ISR_ADCBURST_DONE;
+    SREG = oldSREG;
+}
+
+// clear the latched alarms in mask so they can latch again
+void adc_alarm_ack(uint8_t mask)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_alarm_latched &= ~mask;
+        adc_alarm_new &= ~mask;
+    }
+}
+
+// statistics for the channels in mask over a window (1..60000 milliseconds), or since the last read (zero)
+void adc_stat_start(uint8_t mask, uint16_t window_ms)
 {
-    int local = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_stat_window = ( (unsigned long) window_ms * (F_CPU / 1000UL) ) / TICK_FINE_CLOCKS;
+        unsigned long now = ticksFine();
+        stats_flip(now); // both sets are cleared
+        stats_flip(now);
+        adc_stat_mask = mask;
+    }
+}
+
+// the finished set of statistics, without a window it is the set since the last read and a new one starts
+void adc_stat_take(struct Adc_Stats *copy)
+{
+    if (!adc_stat_window)
+    {
+        uint8_t oldSREG = SREG;
+        cli();
+        unsigned long now = ticksFine(); // needs interrupts off
+        SREG = oldSREG;
+        stats_flip(now); // the ISR only adds to the live set, and does not flip without a window
+        memcpy(copy, &adc_stats[adc_stats_live ^ 1], sizeof(struct Adc_Stats));
+        return;
+    }
+    uint8_t live;
+    do
+    {
+        live = adc_stats_live;
+        memcpy(copy, &adc_stats[live ^ 1], sizeof(struct Adc_Stats));
+    } while (live != adc_stats_live); // the ISR finished a window during the copy
+}
+
+// start a capture of the channels in mask, it stops after frames (zero keeps the newest until stopped). 
+// Returns 0 if the mask is empty or frames is more than the ring holds.
+uint8_t adc_capture_start(uint8_t mask, uint16_t frames)
+{
+    uint8_t readings = 0;
+    for (uint8_t ch = ADC_CH_ADC0; ch <= ADC_CH_ADC7; ch++)
+    {
+        if (mask & (1<<ch)) readings++;
+    }
+    if (!readings) return 0;
+    uint8_t size = ADC_CAPTURE_STAMP + (readings * 12 + 7) / 8;
+    if (frames > (ADC_CAPTURE_SIZE / size)) return 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_capture_frame_size = size;
+        adc_capture_frames = ADC_CAPTURE_SIZE / size;
+        adc_capture_head = 0;
+        adc_capture_count = 0;
+        adc_capture_left = frames;
+        adc_capture_channels = mask;
+        adc_trig_state = ADC_TRIG_OFF;
+        adc_capture_mask = mask;
+    }
+    return 1;
+}
+
+// start a capture of the channels in mask that freezes post frames after the adc_trig event with pre frames 
+// before it. Returns 0 if the mask is empty or the frames do not fit in the ring.
+uint8_t adc_capture_trigger(uint8_t mask, uint16_t pre, uint16_t post)
+{
+    if ( !adc_capture_start(mask, 0) ) return 0;
+    if ( ( (uint32_t) pre + 1 + post ) > adc_capture_frames )
+    {
+        adc_capture_stop();
+        return 0;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_trig.pre = pre;
+        adc_trig.post = post;
+        trig_last = adc[adc_trig.ch];
+        adc_trig_state = ADC_TRIG_PRE;
+    }
+    return 1;
+}
+
+// stop taking frames, what was captured stays in the ring (a frozen trigger capture stays done)
+void adc_capture_stop(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_capture_mask = 0;
+        if (adc_trig_state != ADC_TRIG_DONE) adc_trig_state = ADC_TRIG_OFF;
+    }
+}
+
+// index of the oldest frame in the ring
+uint16_t adc_capture_oldest(void)
+{
+    uint16_t oldest;
+    if (!adc_capture_frames) return 0; // nothing was captured
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        oldest = (adc_capture_head + adc_capture_frames - adc_capture_count) % adc_capture_frames;
+    }
+    return oldest;
+}
+
+// return four byes from the last ADC update with an atomic transaction to make sure ISR does not change it durring the read
+int32_t adcAtomic(ADC_CH_t channel)
+{
+    int32_t local = 0;
     if (channel < ADC_CHANNELS) 
     {
         // an stomic transaction is done by turning off interrupts
         uint8_t oldSREG = SREG;
         cli();           // clear the global interrupt mask.
-        local = adc[channel]; // there are two bytes to copy but nothing can change at the moment
+        local = adc[channel]; // there are four bytes to copy but nothing can change at the moment
         SREG = oldSREG;  // restore global interrupt if they were enabled
     }
     return local;
 
 }
 
-// single channel conversion (blocking)
-int adcSingle(ADC_CH_t channel)
+// copy the last finished burst, if the ISR flips to the next burst during the copy it is done again
+void adcSnapshot(struct Adc_Snapshot *copy)
+{
+    uint8_t front;
+    do
+    {
+        front = adc_snap_front;
+        memcpy(copy, &adc_snap[front], sizeof(struct Adc_Snapshot));
+    } while ( (front != adc_snap_front) || (copy->seq != *(volatile uint16_t *) &adc_snap[front].seq) );
+}
+
+// set the filter of a channel, it starts again from the next reading
+void adc_filter_set(ADC_CH_t channel, ADC_FILTER_t kind, uint8_t n)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_filter[channel].kind = kind;
+        adc_filter[channel].n = n;
+        adc_filter[channel].primed = 0;
+        if (kind == ADC_FILTER_NONE) adc_filtered[channel] = adc[channel];
+    }
+}
+
+// single channel conversion (blocking), with the channel accumulation it takes up to 128 conversions
+int32_t adcSingle(ADC_CH_t channel)
 {
     if (adc_auto_conversion)
     {
@@ -155,7 +809,8 @@ int adcSingle(ADC_CH_t channel)
     {
         channel_setup(channel);
         while ( !(ADC0.INTFLAGS & ADC_RESRDY_bm) );   // Check if the conversion is done
-        int local = ADC0.RES;                         // Clears the interrupt flag
+        int32_t local = adc_result();                 // Clears the interrupt flag
+        if (alarm_hit()) alarm_latch(channel, local);
         return local;
     }
 }
@@ -7,7 +7,7 @@
 // reperesents 1/1024 of the reference. The last slot has issues see datasheet.
 // the ADC channel can be used with analogRead(ADC0)*(<referance>/1024.0)
 
-// enumeraiton names for ADC_CH_<node> from schematic
+// enumeraiton names for ADC_CH_<node> from schematic, a channel can select another input (see references.h ADC_INPUT_t)
 typedef enum ADC_CH_enum {
     ADC_CH_ADC0, // this channels measures AIN0 to GND, AIN0 is on pin PD0
     ADC_CH_ADC1, // this channels measures AIN1 to GND, AIN1 is on pin PD1
@@ -20,7 +20,11 @@ typedef enum ADC_CH_enum {
     ADC_CHANNELS
 } ADC_CH_t;
 
-extern volatile int adc[];
+// a reading is 12 bits unless the channel accumulates samples in hardware and is set wider (up to 16 bits)
+#define ADC_BITS 12
+#define ADC_BITS_MAX 16
+
+extern volatile int32_t adc[];
 extern volatile ADC_CH_t adc_channel;
 extern volatile VREF_REFSEL_t analog_reference;
 
@@ -30,11 +34,204 @@ extern volatile uint8_t adc_isr_status;
 extern uint8_t adc_auto_conversion; // don't do single conversions when auto_conversion is running
 
 extern void init_ADC_single_conversion(void);
-extern int adcAtomic(ADC_CH_t channel);
-extern int adcSingle(ADC_CH_t channel);
+extern int32_t adcAtomic(ADC_CH_t channel);
+extern int32_t adcSingle(ADC_CH_t channel);
+extern uint8_t adc_acc_bits_max(ADC_SAMPNUM_t sampnum);
 
 #define FREE_RUNNING 1
 #define BURST_MODE 0
 extern void enable_ADC_auto_conversion(uint8_t free_run);
 
+// The ISR scans the channels in the order of a plan that groups them by reference, so the reference settling 
+// (INITDLY) is paid once for each group. A channel with a divisor of n (a power of two up to 128) is converted 
+// on every nth burst, zero takes it out of the scan.
+#define ADC_SCAN_DIV_MAX 128
+extern uint8_t adc_scan_div[];
+extern uint8_t adc_scan_plan[]; // channels in scan order
+extern uint8_t adc_scan_len; // channels in the plan
+extern void adc_scan_plan_build(void);
+extern void adc_scan_set(uint8_t mask, uint8_t div);
+
+// Filters run in the ISR on each reading of a channel with shift-only arithmetic, adc[] keeps the raw reading 
+// and adc_filtered[] the filtered one (it is the raw reading when the channel has no filter).
+typedef enum ADC_FILTER_enum {
+    ADC_FILTER_NONE,
+    ADC_FILTER_EMA, // exponential moving average, alpha is 1/2^n (n is 1..8)
+    ADC_FILTER_BOX, // boxcar average of the last 2^n readings (n is 1..4)
+    ADC_FILTER_MEDIAN // median of the last n readings (n is 3 or 5)
+} ADC_FILTER_t;
+
+#define ADC_FILTER_HIST 16
+
+struct Adc_Filter {
+    uint8_t kind; // ADC_FILTER_t
+    uint8_t n;
+    uint8_t at; // next history slot
+    uint8_t primed; // zero until the first reading fills the history
+    int32_t sum; // EMA reading scaled by 2^n, or the boxcar sum
+    int32_t hist[ADC_FILTER_HIST];
+};
+
+extern struct Adc_Filter adc_filter[];
+extern volatile int32_t adc_filtered[];
+extern void adc_filter_set(ADC_CH_t channel, ADC_FILTER_t kind, uint8_t n);
+
+// Each finished burst (a scan of ADC0..ADC7) is a snapshot, the ISR fills the back buffer and flips 
+// adc_snap_front when ADC7 is done. adcSnapshot() copies the front one without turning off interrupts, 
+// so all the channels it gives are from the same burst (e.g., a voltage and current pair for power).
+struct Adc_Snapshot {
+    uint16_t seq; // counts bursts
+    int32_t adc[ADC_CHANNELS];
+    int32_t filtered[ADC_CHANNELS];
+};
+
+extern struct Adc_Snapshot adc_snap[2];
+extern volatile uint8_t adc_snap_front; // a byte so the reader gets it in one load
+extern void adcSnapshot(struct Adc_Snapshot *copy);
+
+// Alarms use the ADC window comparator (WINCM with WINLT/WINHT) which is set for each channel as the 
+// scan selects it, so the compare is done in hardware. The ISR latches the channel with the time stamp 
+// (ticksFine) and reading of the first hit, the latch holds until it is acknowledged. Levels are in counts 
+// of the channel reading (its /acc width), below is under lo, above is over hi.
+struct Adc_Alarm {
+    ADC_WINCM_t mode; // ADC_WINCM_NONE_gc is off
+    uint16_t lo;
+    uint16_t hi;
+    unsigned long stamp;
+    int32_t value;
+};
+
+extern struct Adc_Alarm adc_alarm[];
+extern volatile uint8_t adc_alarm_latched; // bit n is set when ADCn has hit its window
+extern volatile uint8_t adc_alarm_new; // latched alarms that were not pushed yet
+extern void adc_alarm_ack(uint8_t mask);
+
+// conversions started by TCB2 through the event system, the rate is for each channel
+#define ADC_EVENT_RATE_MIN 16
+#define ADC_EVENT_RATE_MAX 4000
+// ADC clock prescaler, ADC_PRESC_DIV is its divisor for the conversion timing
+#if F_CPU >= 24000000
+#define ADC_PRESC ADC_PRESC_DIV24_gc              // 1 MHz
+#define ADC_PRESC_DIV 24
+#elif F_CPU >= 20000000
+#define ADC_PRESC ADC_PRESC_DIV20_gc              // 1 MHz
+#define ADC_PRESC_DIV 20
+#elif F_CPU >= 16000000
+#define ADC_PRESC ADC_PRESC_DIV16_gc              // 1 MHz
+#define ADC_PRESC_DIV 16
+#elif F_CPU >= 12000000
+#define ADC_PRESC ADC_PRESC_DIV12_gc              // 1 MHz
+#define ADC_PRESC_DIV 12
+#elif F_CPU >= 8000000
+#define ADC_PRESC ADC_PRESC_DIV8_gc               // 1 MHz
+#define ADC_PRESC_DIV 8
+#elif F_CPU >= 4000000
+#define ADC_PRESC ADC_PRESC_DIV4_gc               // 1 MHz
+#define ADC_PRESC_DIV 4
+#else
+#define ADC_PRESC ADC_PRESC_DIV2_gc               // the lowest setting
+#define ADC_PRESC_DIV 2
+#endif
+// ADC clocks of a conversion (DS 12-bit timing), sample is 2 clocks plus SAMPCTRL and INITDLY is DLY16
+#define ADC_SAMPLE_CLKS 2
+#define ADC_CONV_CLKS 13
+#define ADC_INITDLY_CLKS 16
+// CPU clocks of the ADC ISR from the interrupt, worst case with filters, statistics, and capture on: to the mux 
+// select for the next channel, all of it for a reading in a burst, and all of it for the reading that ends a burst 
+// (snapshot flip, capture frame, statistics flip). These are counted from the code with some room, the adc rows 
+// of ../Adc_MC time this ISR on a board (see its README for how the columns give them).
+#define ADC_ISR_SELECT_CLKS 640
+#define ADC_ISR_CH_CLKS 1200
+#define ADC_ISR_BURST_CLKS 3200
+#ifdef ADC_ISR_PROBE
+extern void adc_isr(void); // the ISR body, for the benchmark to time
+extern volatile uint16_t adc_isr_selected; // TCB1.CNT when the ISR selected the next channel
+#endif
+extern uint16_t adc_event_rate;
+extern uint32_t adc_event_period_min(void);
+extern uint8_t enable_ADC_event_conversion(uint16_t ch_rate_hz);
+extern uint8_t adc_event_retime(void);
+extern void disable_ADC_event_conversion(void);
+
+// Capture ring of frames taken each time a scan of the channels is done. A frame is a time stamp 
+// (ticksFine, four bytes little endian) and the 12 bit readings of the channels in the mask packed in 
+// channel order, two readings in three bytes (a low byte, a high nibble | b low nibble, b high byte), 
+// an odd reading at the end takes two bytes. Wider (oversampled) readings are cut to their top 12 bits.
+#define ADC_CAPTURE_SIZE 8192
+#define ADC_CAPTURE_STAMP 4
+extern uint8_t adc_capture[];
+extern volatile uint8_t adc_capture_mask; // channels to capture, zero when not capturing
+extern uint8_t adc_capture_channels; // channels in the frames of the ring
+extern uint8_t adc_capture_frame_size; // bytes in a frame
+extern uint16_t adc_capture_frames; // frames the ring holds
+extern volatile uint16_t adc_capture_head; // the next frame is written here
+extern volatile uint16_t adc_capture_count; // frames in the ring
+extern volatile uint16_t adc_capture_left; // frames until the capture stops, zero is until stopped
+extern uint8_t adc_capture_start(uint8_t mask, uint16_t frames);
+extern void adc_capture_stop(void);
+extern uint16_t adc_capture_oldest(void);
+
+// A trigger on one channel freezes the capture ring with pre frames before the event and post frames after 
+// it (a software oscilloscope). Levels are in counts of the channel reading (its /acc width).
+typedef enum ADC_TRIG_MODE_enum {
+    ADC_TRIG_ABOVE, // reading at or above lo
+    ADC_TRIG_BELOW, // reading at or below lo
+    ADC_TRIG_RISE, // reading goes from below lo to at or above it
+    ADC_TRIG_FALL, // reading goes from above lo to at or below it
+    ADC_TRIG_INSIDE, // reading from lo to hi
+    ADC_TRIG_OUTSIDE // reading below lo or above hi
+} ADC_TRIG_MODE_t;
+
+typedef enum ADC_TRIG_STATE_enum {
+    ADC_TRIG_OFF,
+    ADC_TRIG_PRE, // filling the pre trigger frames
+    ADC_TRIG_ARMED, // looking for the event
+    ADC_TRIG_POST, // taking the post trigger frames
+    ADC_TRIG_DONE // the ring is frozen around the event
+} ADC_TRIG_STATE_t;
+
+struct Adc_Trig {
+    uint8_t mode; // ADC_TRIG_MODE_t
+    uint8_t ch;
+    int32_t lo;
+    int32_t hi;
+    uint16_t pre;
+    uint16_t post;
+    unsigned long stamp; // ticksFine() of the trigger frame
+};
+
+extern struct Adc_Trig adc_trig;
+extern volatile uint8_t adc_trig_state;
+extern uint8_t adc_capture_trigger(uint8_t mask, uint16_t pre, uint16_t post);
+
+// Statistics (count, min, max, mean, variance) of the readings of each channel in the mask, the ISR adds 
+// each reading with integer math. The sums are of the reading less the first one of the set (shifted data) 
+// so they are exact and the variance does not lose digits to a large mean. With a window the ISR starts 
+// a new set when a burst ends after it and the finished set is what a reader gets, without a window the 
+// reader takes the set and a new one starts (reset on read). The ISR and the reader use different sets 
+// so neither has to turn off interrupts.
+#define ADC_STAT_COUNT_MAX 0x7FFF // readings past this are not added, so the sum of a 16 bit spread fits in 32 bits
+
+struct Adc_Stat {
+    uint16_t n;
+    int32_t first; // reading the sums are from
+    int32_t min;
+    int32_t max;
+    int32_t sum; // of reading - first
+    uint64_t sumsq; // of (reading - first)^2
+};
+
+struct Adc_Stats {
+    unsigned long start; // ticksFine() when the set started
+    unsigned long end; // ticksFine() when it was finished
+    struct Adc_Stat ch[ADC_CHANNELS];
+};
+
+extern struct Adc_Stats adc_stats[2];
+extern volatile uint8_t adc_stats_live; // the set the ISR adds to
+extern volatile uint8_t adc_stat_mask; // channels with statistics, zero is off
+extern unsigned long adc_stat_window; // ticksFine() counts, zero is since the last read
+extern void adc_stat_start(uint8_t mask, uint16_t window_ms);
+extern void adc_stat_take(struct Adc_Stats *copy);
+
 #endif // AdcISR_h
@@ -0,0 +1,22 @@
+#ifndef EeMap_H
+#define EeMap_H
+
+// Where the applications keep their settings in EEPROM (the size is in ioavr128da28.h).
+// Settings are at the top of EEPROM so the low addresses are free to play with (e.g., /0/ee).
+// An erased EEPROM reads 0xFF so a setting uses a key value rather than a flag bit.
+
+// command line mode (mode.c)
+#define EE_MODE_ECHO_ADDR (EEPROM_SIZE - 1)
+#define EE_MODE_ECHO_OFF 0x51 // any other value is the default, echo is on
+
+// boot script (script.c), lines are saved without the address and end with a null, an erased byte ends the script
+#define EE_SCRIPT_AUTO_ADDR (EEPROM_SIZE - 2)
+#define EE_SCRIPT_AUTO_ON 0x52 // run the script at power-up, any other value is the default, do not run it
+#define EE_SCRIPT_SIZE 128
+#define EE_SCRIPT_ADDR (EEPROM_SIZE - 2 - EE_SCRIPT_SIZE)
+
+// ADC calibration record (references.c), a version and CRC16 are checked before it is used
+#define EE_CAL_SIZE 96
+#define EE_CAL_ADDR (EE_SCRIPT_ADDR - EE_CAL_SIZE)
+
+#endif // EeMap_H 
@@ -0,0 +1,325 @@
+/*
+Resumable JSON writer that fills the UART0 transmit buffer without blocking
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+A reply is written as a list of items (begin, key, value, end...). Each call of the
+command handler does a pass over the whole list; items sent on an earlier pass are
+skipped, and the pass stops on the first item that does not fit in the transmit
+buffer. The item is split at the exact byte, and the next pass resumes from there.
+
+    json_start(JSON_QUOTE_NUMBERS); // once when the command starts
+    ...
+    json_pass(); // each time the handler is called
+    json_obj_begin();
+    json_key_P(PSTR("ADC0"));
+    json_int(adc0);
+    json_obj_end();
+    json_eol();
+    if (json_blocked()) return; // come back when the buffer has room
+    initCommandBuffer(); // reply is done
+
+The handler must give the same items in the same order on each pass. Use json_pending()
+to skip work (e.g., a conversion) for items that were already sent or will not fit.
+*/
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "uart0_bsd.h"
+#include "json_bsd.h"
+
+// progress over the passes of a reply
+static uint16_t json_item; // item count in this pass
+static uint16_t json_sent; // items that were fully sent
+static uint8_t json_offset; // bytes already sent from the item json_sent
+static uint8_t json_room; // transmit buffer bytes left for this pass
+static uint8_t json_stop; // this pass ran out of room
+
+// structure state, rebuilt on each pass as the items are walked
+static uint8_t json_depth;
+static uint8_t json_first; // bit for each depth, set until the first value is in the container
+static uint8_t json_after_key;
+static uint8_t json_options;
+
+// how json_emit walks its string
+#define EMIT_FLASH 0x01 // string is in flash
+#define EMIT_QUOTE 0x02 // put quotes around the string and escape its content
+#define EMIT_COLON 0x04 // add a ':' after it (a key)
+#define EMIT_VALUE 0x08 // it is a value (or key) so a comma may be needed before it
+#define EMIT_HELD 0x10 // string is in json_buf, hold it if the item is split
+
+static char json_buf[JSON_KEY_SIZE]; // numbers and keys are formatted here
+static char json_held[JSON_KEY_SIZE]; // a formatted item that was split, so it resumes with the same text
+
+// start a new reply
+void json_start(uint8_t options)
+{
+    json_sent = 0;
+    json_offset = 0;
+    json_stop = 0;
+    json_options = options;
+}
+
+// start a pass over the reply items
+void json_pass(void)
+{
+    json_item = 0;
+    json_depth = 0;
+    json_first = 0x01;
+    json_after_key = 0;
+    json_stop = 0;
+    json_room = uart0_availableForWriteBytes();
+}
+
+// the last pass did not finish, call the handler again after the buffer drains
+uint8_t json_blocked(void)
+{
+    return json_stop;
+}
+
+// the next item will be sent by this pass
+uint8_t json_pending(void)
+{
+    return ( (!json_stop) && (json_item >= json_sent) );
+}
+
+// send one byte if it is past what was already sent and there is room
+static inline void json_byte(uint8_t *at, char c)
+{
+    if (json_stop) return;
+    if (*at >= json_offset)
+    {
+        if (!json_room)
+        {
+            json_offset = *at;
+            json_stop = 1;
+            return;
+        }
+        putchar(c);
+        json_room--;
+    }
+    (*at)++;
+}
+
+// hex digit for \u00XX escapes
+static char json_hex(uint8_t nibble)
+{
+    return (nibble < 10) ? ('0' + nibble) : ('a' + nibble - 10);
+}
+
+// walk the structure state for one item and send what has not been sent
+static void json_emit(const char *str, uint8_t how)
+{
+    uint8_t comma = 0;
+    if (how & EMIT_VALUE)
+    {
+        if (json_after_key)
+        {
+            json_after_key = 0;
+        }
+        else if ( json_depth && !(json_first & (1 << json_depth)) )
+        {
+            comma = 1;
+        }
+        json_first &= ~(1 << json_depth);
+    }
+    if (how & EMIT_COLON)
+    {
+        json_after_key = 1;
+    }
+
+    // items already sent only needed the structure update
+    if ( json_stop || (json_item++ < json_sent) ) return;
+
+    // a split number resumes from the text that was started, not a new reading
+    if ( (how & EMIT_HELD) && json_offset ) str = json_held;
+    const char *start = str;
+
+    uint8_t at = 0;
+    if (comma) json_byte(&at, ',');
+    if (how & EMIT_QUOTE) json_byte(&at, '"');
+    for (;;)
+    {
+        char c = (how & EMIT_FLASH) ? pgm_read_byte(str) : *str;
+        if (c == '\0') break;
+        str++;
+        if ( (how & EMIT_QUOTE) && ( (c == '"') || (c == '\\') ) )
+        {
+            json_byte(&at, '\\');
+            json_byte(&at, c);
+        }
+        else if ( (how & EMIT_QUOTE) && ( (uint8_t)c < 0x20 ) )
+        {
+            json_byte(&at, '\\');
+            json_byte(&at, 'u');
+            json_byte(&at, '0');
+            json_byte(&at, '0');
+            json_byte(&at, json_hex( ((uint8_t)c) >> 4));
+            json_byte(&at, json_hex( ((uint8_t)c) & 0x0F));
+        }
+        else
+        {
+            json_byte(&at, c);
+        }
+    }
+    if (how & EMIT_QUOTE) json_byte(&at, '"');
+    if (how & EMIT_COLON) json_byte(&at, ':');
+    if (json_stop)
+    {
+        if ( (how & EMIT_HELD) && (start != json_held) ) strcpy(json_held, start);
+        return;
+    }
+
+    // item is done
+    json_sent++;
+    json_offset = 0;
+}
+
+void json_obj_begin(void)
+{
+    json_emit(PSTR("{"), EMIT_FLASH | EMIT_VALUE);
+    if (json_depth < (JSON_MAX_DEPTH - 1)) json_depth++;
+    json_first |= (1 << json_depth);
+}
+
+void json_obj_end(void)
+{
+    if (json_depth) json_depth--;
+    json_emit(PSTR("}"), EMIT_FLASH);
+}
+
+void json_arr_begin(void)
+{
+    json_emit(PSTR("["), EMIT_FLASH | EMIT_VALUE);
+    if (json_depth < (JSON_MAX_DEPTH - 1)) json_depth++;
+    json_first |= (1 << json_depth);
+}
+
+void json_arr_end(void)
+{
+    if (json_depth) json_depth--;
+    json_emit(PSTR("]"), EMIT_FLASH);
+}
+
+void json_key(const char *key)
+{
+    json_emit(key, EMIT_QUOTE | EMIT_COLON | EMIT_VALUE);
+}
+
+void json_key_P(const char *key)
+{
+    json_emit(key, EMIT_FLASH | EMIT_QUOTE | EMIT_COLON | EMIT_VALUE);
+}
+
+// format digits of value at the end of json_buf, returns where they start
+static char *json_digits(uint32_t value, uint8_t negative)
+{
+    char *p = &json_buf[JSON_KEY_SIZE - 1];
+    *p = '\0';
+    do
+    {
+        *--p = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    if (negative) *--p = '-';
+    return p;
+}
+
+// a key made from a prefix in flash and an index, e.g., "ADC" and 3 gives "ADC3"
+void json_key_idx_P(const char *prefix, uint8_t index)
+{
+    if (json_pending())
+    {
+        char *digits = json_digits(index, 0);
+        uint8_t len = strlen_P(prefix);
+        uint8_t room = digits - json_buf;
+        if (len > room) len = room;
+        memmove(json_buf + len, digits, &json_buf[JSON_KEY_SIZE] - digits);
+        memcpy_P(json_buf, prefix, len);
+    }
+    else
+    {
+        json_buf[0] = '\0'; // sent or blocked, only the structure is walked
+    }
+    json_emit(json_buf, EMIT_HELD | EMIT_QUOTE | EMIT_COLON | EMIT_VALUE);
+}
+
+static void json_number(char *digits)
+{
+    uint8_t how = EMIT_HELD | EMIT_VALUE;
+    if (json_options & JSON_QUOTE_NUMBERS) how |= EMIT_QUOTE;
+    json_emit(digits, how);
+}
+
+void json_int(int32_t value)
+{
+    uint8_t negative = (value < 0);
+    uint32_t magnitude = negative ? (0 - (uint32_t)value) : (uint32_t)value;
+    json_number(json_digits(magnitude, negative));
+}
+
+void json_uint(uint32_t value)
+{
+    json_number(json_digits(value, 0));
+}
+
+// a value with places decimal digits, e.g., microvolts have 6, shown rounded to decimals (no more than places)
+// json_fixed(1234567, FIXED_MICRO_PLACES, 4) gives 1.2346
+void json_fixed(int32_t value, uint8_t places, uint8_t decimals)
+{
+    if (decimals > places) decimals = places;
+    uint8_t negative = (value < 0);
+    uint32_t magnitude = negative ? (0 - (uint32_t)value) : (uint32_t)value;
+
+    // drop the digits that are not shown, round half away from zero
+    for (uint8_t drop = places - decimals; drop; drop--)
+    {
+        uint8_t last = magnitude % 10;
+        magnitude /= 10;
+        if ( (drop == 1) && (last >= 5) ) magnitude++;
+    }
+
+    if (!magnitude) negative = 0; // rounded to zero, so no "-0.0000"
+
+    // digits from the right with the point after decimals of them, at least one digit on its left
+    char *p = &json_buf[JSON_KEY_SIZE - 1];
+    *p = '\0';
+    uint8_t digit = 0;
+    do
+    {
+        if ( decimals && (digit == decimals) ) *--p = '.';
+        *--p = '0' + (magnitude % 10);
+        magnitude /= 10;
+        digit++;
+    } while ( magnitude || (digit <= decimals) );
+    if (negative) *--p = '-';
+    json_number(p);
+}
+
+void json_str(const char *str)
+{
+    json_emit(str, EMIT_QUOTE | EMIT_VALUE);
+}
+
+void json_str_P(const char *str)
+{
+    json_emit(str, EMIT_FLASH | EMIT_QUOTE | EMIT_VALUE);
+}
+
+// end of the reply line
+void json_eol(void)
+{
+    json_emit(PSTR("\r\n"), EMIT_FLASH);
+}
@@ -0,0 +1,38 @@
+#ifndef JsonBsd_h
+#define JsonBsd_h
+
+#include <stdint.h>
+
+// options for json_start()
+#define JSON_QUOTE_NUMBERS 0x01 // numbers are sent as strings, e.g., {"ADC0":"4095"}
+
+// keys made by json_key_idx_P and formatted numbers are held in a small buffer
+#define JSON_KEY_SIZE 14
+
+// calibrated readings are held as integers of micro units (e.g., microvolts) so printf does not need float support
+typedef int32_t fixed_micro_t;
+#define FIXED_MICRO_PLACES 6
+
+// nesting of objects and arrays
+#define JSON_MAX_DEPTH 8
+
+extern void json_start(uint8_t options);
+extern void json_pass(void);
+extern uint8_t json_blocked(void);
+extern uint8_t json_pending(void);
+
+extern void json_obj_begin(void);
+extern void json_obj_end(void);
+extern void json_arr_begin(void);
+extern void json_arr_end(void);
+extern void json_key(const char *key);
+extern void json_key_P(const char *key);
+extern void json_key_idx_P(const char *prefix, uint8_t index);
+extern void json_int(int32_t value);
+extern void json_uint(uint32_t value);
+extern void json_fixed(int32_t value, uint8_t places, uint8_t decimals);
+extern void json_str(const char *str);
+extern void json_str_P(const char *str);
+extern void json_eol(void);
+
+#endif // JsonBsd_h
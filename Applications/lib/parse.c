@@ -20,6 +20,7 @@ https://onebyezero.blogspot.com/2018/12/string-tokenization-in-c.html
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <avr/pgmspace.h>
 #include "parse.h"
 #include "uart0_bsd.h"
@@ -34,9 +35,23 @@ char *command;
 char *arg[MAX_ARGUMENT_COUNT];
 uint8_t arg_count;
 
+// typed arguments after they are checked against a command schema
+ARG_VAL_t arg_val[MAX_ARGUMENT_COUNT];
+uint8_t arg_err_index;
+ARG_ERR_t arg_err;
+
 // command loopback happons from the addressed device
 uint8_t echo_on;
 
+// when set, an addressed command is not echoed (only the reply is sent)
+uint8_t command_quiet;
+
+// when set, bytes that arrive while a command is in process are queued rather than used to abort it
+uint8_t command_pipeline;
+static char command_queue[COMMAND_QUEUE_SIZE];
+static uint8_t command_queue_head;
+static uint8_t command_queue_tail;
+
 // Hold the command in the buffer and spin loop until the chunks of JSON 
 // are done outputting. Each chunk should be less than 32 bytes since that 
 // is the AVR UART buffer size. The main spin loop continues running until 
@@ -62,7 +77,7 @@ void StartEchoWhenAddressed(char address)
     if ( (!echo_on) && (command_buf[0] == '/') && (command_buf[1] == address) )
     {
         echo_on = 1;
-        printf_P(PSTR("%c%c"),command_buf[0], command_buf[1]);
+        if (!command_quiet) printf_P(PSTR("%c%c"),command_buf[0], command_buf[1]);
     }
 }
 
@@ -73,7 +88,7 @@ void AssembleCommand(int input)
     if ( (input == '\r') || (input == '\n') ) // pressing enter in picocom sends a \r
     {
         //echo both carrage return and newline.
-        if (echo_on) printf("\r\n");
+        if (echo_on && !command_quiet) printf("\r\n");
         
         // finish command line as a null terminated string
         command_buf[command_head] = '\0';
@@ -98,7 +113,7 @@ void AssembleCommand(int input)
             {
                 command_head--; // move pointer back one
                 command_buf[command_head] = '\0'; // invalidate
-                if (echo_on)
+                if (echo_on && !command_quiet)
                 {
                     putchar ('\b'); // backspace
                     putchar (' '); // space to clear what was
@@ -109,7 +124,7 @@ void AssembleCommand(int input)
         else
         {
             //echo the input  
-            if (echo_on) putchar(input);
+            if (echo_on && !command_quiet) putchar(input);
 
             // assemble the command
             command_buf[command_head] = input;
@@ -325,3 +340,242 @@ uint8_t is_arg_in_uint8_range(uint8_t arg_num, uint8_t min, uint8_t max)
     return argument;
 }
 
+// convert decimal digits at str into *value, a junk char or overflow fails
+static uint8_t str_to_ul(const char *str, uint32_t *value, char end)
+{
+    uint32_t ul = 0;
+    if ( !isdigit(*str) ) return 0;
+    while ( isdigit(*str) )
+    {
+        uint8_t digit = *str - '0';
+        if (ul > ( (0xFFFFFFFFUL - digit) / 10) ) return 0; // would overflow
+        ul = (ul * 10) + digit;
+        str++;
+    }
+    if (*str != end) return 0;
+    *value = ul;
+    return 1;
+}
+
+// index of word in a flash token list (e.g., "LOW\0HIGH\0"), returns 0xFF if not found
+static uint8_t token_index(const char *word, const char *tokens)
+{
+    for (uint8_t index = 0; pgm_read_byte(tokens) != '\0'; index++)
+    {
+        if (strcmp_P(word, tokens) == 0) return index;
+        tokens += strlen_P(tokens) + 1;
+    }
+    return 0xFF;
+}
+
+// word n of a flash token list (e.g., 1 of "LOW\0HIGH\0" is "HIGH"), past the last word it is the empty word that ends the list
+const char *token_word(const char *tokens, uint8_t n)
+{
+    for (; n && (pgm_read_byte(tokens) != '\0'); n--)
+    {
+        tokens += strlen_P(tokens) + 1;
+    }
+    return tokens;
+}
+
+// convert hex digits at str (after a 0x) into *value, junk or more than 8 digits fails
+static uint8_t str_to_hex(const char *str, uint32_t *value)
+{
+    uint32_t ul = 0;
+    uint8_t digits = 0;
+    for ( ; *str != '\0'; str++)
+    {
+        if ( !isxdigit(*str) || (++digits > 8) ) return 0;
+        ul = (ul << 4) | (isdigit(*str) ? (*str - '0') : ((*str | 0x20) - 'a' + 10));
+    }
+    if (!digits) return 0;
+    *value = ul;
+    return 1;
+}
+
+// Check each argument against a schema (in flash) and convert it into arg_val[] so the 
+// steps of a reply do not need to parse the same argument again. When there are more 
+// arguments than schema entries the last entry is used for the rest (e.g., a list of channels).
+// Returns 1 when all arguments are valid, otherwise 0 with arg_err_index and arg_err set.
+uint8_t typeArguments(const struct Arg_Schema *schema, uint8_t schema_size)
+{
+    struct Arg_Schema entry;
+    arg_err = ARG_ERR_NONE;
+    for (arg_err_index = 0; arg_err_index < arg_count; arg_err_index++)
+    {
+        uint8_t at = (arg_err_index < schema_size) ? arg_err_index : (schema_size - 1);
+        memcpy_P(&entry, &schema[at], sizeof(struct Arg_Schema));
+        char *str = arg[arg_err_index];
+        ARG_VAL_t *val = &arg_val[arg_err_index];
+        switch (entry.type)
+        {
+        case ARG_TYPE_INT32:
+        {
+            uint32_t ul;
+            uint8_t negative = (str[0] == '-');
+            if ( !str_to_ul(str + negative, &ul, '\0') || (ul > 0x80000000UL) || ( (ul == 0x80000000UL) && !negative) )
+            {
+                arg_err = ARG_ERR_NAN;
+                return 0;
+            }
+            val->i32 = negative ? (int32_t)(0 - ul) : (int32_t)ul;
+            if ( (val->i32 < entry.min) || (val->i32 > entry.max) )
+            {
+                arg_err = ARG_ERR_RANGE;
+                return 0;
+            }
+            break;
+        }
+        case ARG_TYPE_UINT32:
+            if ( !str_to_ul(str, &val->u32, '\0') )
+            {
+                arg_err = ARG_ERR_NAN;
+                return 0;
+            }
+            if ( (val->u32 < (uint32_t)entry.min) || (val->u32 > (uint32_t)entry.max) )
+            {
+                arg_err = ARG_ERR_RANGE;
+                return 0;
+            }
+            break;
+        case ARG_TYPE_TOKEN:
+            val->token = token_index(str, entry.tokens);
+            if (val->token == 0xFF)
+            {
+                arg_err = ARG_ERR_TOKEN;
+                return 0;
+            }
+            break;
+        case ARG_TYPE_RANGE:
+        {
+            uint32_t lo;
+            uint32_t hi;
+            char *dash = strchr(str, '-');
+            if (dash == NULL)
+            {
+                if ( !str_to_ul(str, &lo, '\0') )
+                {
+                    arg_err = ARG_ERR_NAN;
+                    return 0;
+                }
+                hi = lo;
+            }
+            else if ( !str_to_ul(str, &lo, '-') || !str_to_ul(dash + 1, &hi, '\0') )
+            {
+                arg_err = ARG_ERR_NAN;
+                return 0;
+            }
+            if ( (lo > hi) || (lo < (uint32_t)entry.min) || (hi > (uint32_t)entry.max) )
+            {
+                arg_err = ARG_ERR_RANGE;
+                return 0;
+            }
+            val->range.lo = (uint16_t)lo;
+            val->range.hi = (uint16_t)hi;
+            break;
+        }
+        case ARG_TYPE_SET:
+        {
+            // bits min..max are the members that are allowed
+            uint32_t allowed = (0xFFFFFFFFUL >> (31 - (uint8_t)entry.max)) & (0xFFFFFFFFUL << (uint8_t)entry.min);
+            if (strcmp_P(str, PSTR("all")) == 0)
+            {
+                val->set = allowed;
+                break;
+            }
+            uint32_t lo;
+            uint32_t hi;
+            char *dash = strchr(str, '-');
+            if ( (str[0] == '0') && (str[1] == 'x') )
+            {
+                if ( !str_to_hex(str + 2, &val->set) )
+                {
+                    arg_err = ARG_ERR_NAN;
+                    return 0;
+                }
+                if ( (!val->set) || (val->set & ~allowed) )
+                {
+                    arg_err = ARG_ERR_RANGE;
+                    return 0;
+                }
+                break;
+            }
+            else if (dash == NULL)
+            {
+                if ( !str_to_ul(str, &lo, '\0') )
+                {
+                    arg_err = ARG_ERR_NAN;
+                    return 0;
+                }
+                hi = lo;
+            }
+            else if ( !str_to_ul(str, &lo, '-') || !str_to_ul(dash + 1, &hi, '\0') )
+            {
+                arg_err = ARG_ERR_NAN;
+                return 0;
+            }
+            if ( (lo > hi) || (lo < (uint32_t)entry.min) || (hi > (uint32_t)entry.max) )
+            {
+                arg_err = ARG_ERR_RANGE;
+                return 0;
+            }
+            val->set = (0xFFFFFFFFUL >> (31 - (uint8_t)hi)) & (0xFFFFFFFFUL << (uint8_t)lo);
+            break;
+        }
+        default:
+            arg_err = ARG_ERR_TOKEN;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// argument is a batch form (e.g., all, 0-7 or 0xF0) rather than a single number
+uint8_t is_arg_batch(uint8_t arg_num)
+{
+    if (arg_num >= arg_count) return 0;
+    char *str = arg[arg_num];
+    return ( (strcmp_P(str, PSTR("all")) == 0) || (strchr(str, '-') != NULL) || ( (str[0] == '0') && (str[1] == 'x') ) );
+}
+
+// Pipelined mode lets a host send several command lines without waiting for each reply.
+// The main loop queues input that arrives while a command is in process (rather than
+// dumping the reply to limit a collision), and assembles the next command from the
+// queue before taking new input from the UART, so replies come back in order.
+// A byte that does not fit is dropped, the host should keep what it has in flight
+// under COMMAND_QUEUE_SIZE bytes.
+void QueueCommandInput(int input)
+{
+    uint8_t next = (command_queue_head + 1) & COMMAND_QUEUE_MASK;
+    if (next != command_queue_tail)
+    {
+        command_queue[command_queue_head] = (char) input;
+        command_queue_head = next;
+    }
+}
+
+// number of queued bytes
+uint8_t CommandQueued(void)
+{
+    return (command_queue_head - command_queue_tail) & COMMAND_QUEUE_MASK;
+}
+
+// next queued byte, or -1 (EOF) if the queue is empty
+int DequeueCommandInput(void)
+{
+    if (command_queue_head == command_queue_tail) return -1;
+    int input = (uint8_t) command_queue[command_queue_tail];
+    command_queue_tail = (command_queue_tail + 1) & COMMAND_QUEUE_MASK;
+    return input;
+}
+
+void EmptyCommandQueue(void)
+{
+    command_queue_tail = command_queue_head;
+}
+
+// nothing is in process, assembled, or queued, e.g., the serial output is free for data the node pushes
+uint8_t is_command_idle(void)
+{
+    return ( (!command_done) && (!command_head) && (command_queue_head == command_queue_tail) );
+}
@@ -5,10 +5,52 @@
 #define COMMAND_BUFFER_SIZE 32
 #define COMMAND_BUFFER_MASK (COMMAND_BUFFER_SIZE - 1)
 
+// pipelined command lines are held in a byte queue while a command is in process (a power of two)
+#define COMMAND_QUEUE_SIZE 128
+#define COMMAND_QUEUE_MASK (COMMAND_QUEUE_SIZE - 1)
+
 // arguments that can be found after a command on the command line
 #define MAX_ARGUMENT_COUNT 5
 #define ARGUMNT_DELIMITER ','
 
+// argument types that typeArguments() can convert, a schema has one entry per argument position
+typedef enum ARG_TYPE_enum
+{
+    ARG_TYPE_INT32,  // signed decimal, e.g., -12
+    ARG_TYPE_UINT32,  // unsigned decimal, e.g., 4095 (min and max are compared as unsigned)
+    ARG_TYPE_TOKEN,  // index of a word in a token list, e.g., LOW|HIGH gives 0|1
+    ARG_TYPE_RANGE,  // a number or a range of numbers, e.g., 3 or 0-7
+    ARG_TYPE_SET  // bit mask of numbers min..max (max no more than 31), e.g., all, 0-7, 0xF0 or 3
+} ARG_TYPE_t;
+
+// reason typeArguments() rejected the argument at arg_err_index
+typedef enum ARG_ERR_enum
+{
+    ARG_ERR_NONE,
+    ARG_ERR_NAN,  // not a number (or has junk after the digits)
+    ARG_ERR_RANGE,  // number is outside min..max (or range start is after its end)
+    ARG_ERR_TOKEN  // word is not in the token list
+} ARG_ERR_t;
+
+// schema entries are placed in flash with PROGMEM
+struct Arg_Schema {
+    uint8_t type; // ARG_TYPE_t
+    int32_t min; // lowest value allowed
+    int32_t max; // highest value allowed
+    const char *tokens; // ARG_TYPE_TOKEN words (in flash) each ended with a null, an empty word ends the list
+};
+
+// typed value of an argument after typeArguments()
+typedef union {
+    int32_t i32;
+    uint32_t u32;
+    uint8_t token;
+    uint32_t set; // bit n is set when n is in the set
+    struct {
+        uint16_t lo;
+        uint16_t hi;
+    } range;
+} ARG_VAL_t;
 
 extern void initCommandBuffer(void);
 extern void StartEchoWhenAddressed(char address);
@@ -17,12 +59,25 @@ extern uint8_t findArgument(uint8_t at_command_buf_offset);
 extern uint8_t findCommand(void);
 extern unsigned long is_arg_in_ul_range (uint8_t arg_num, unsigned long min, unsigned long max);
 extern uint8_t is_arg_in_uint8_range (uint8_t arg_num, uint8_t min, uint8_t max);
+extern uint8_t typeArguments(const struct Arg_Schema *schema, uint8_t schema_size);
+extern const char *token_word(const char *tokens, uint8_t n);
+extern uint8_t is_arg_batch(uint8_t arg_num);
+extern void QueueCommandInput(int input);
+extern uint8_t CommandQueued(void);
+extern int DequeueCommandInput(void);
+extern void EmptyCommandQueue(void);
+extern uint8_t is_command_idle(void);
 
 extern uint8_t command_done;
 extern uint8_t echo_on;
+extern uint8_t command_pipeline;
+extern uint8_t command_quiet;
 extern char command_buf[];
 extern char *command;
 extern char *arg[MAX_ARGUMENT_COUNT];
 extern uint8_t arg_count;
+extern ARG_VAL_t arg_val[MAX_ARGUMENT_COUNT];
+extern uint8_t arg_err_index;
+extern ARG_ERR_t arg_err;
 
 #endif // PARSE_H 
@@ -1,5 +1,5 @@
 /*
-references is a library used to load and set analog conversion references in EEPROM. 
+references is a library used to load and set analog conversion references and calibration from EEPROM. 
 Copyright (C) 2019 Ronald Sutherland
 
 Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
@@ -24,149 +24,251 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <util/crc16.h>
 #include "../lib/parse.h"
 #include "adc_bsd.h"
 #include "references.h"
+#include "eerw_dx.h"
+#include "ee_map.h"
 
 VREF_LOADED_t ref_loaded;
 CALIBRATE_LOADED_t cal_loaded;
-float ref_extern_vdd; // VDD is from the 5V@1A5 SMPS supply (^1 is hacked to input from USB)
-float ref_intern_1v0; // 1V024 +/- 4%, but a bandgap refernace is temperature stable
-float ref_intern_2v0; // 2V048 +/- 4%, but a bandgap refernace is temperature stable
-float ref_intern_4v1; // 4V096 +/- 4%, but a bandgap refernace is temperature stable
+uint32_t ref_extern_vdd; // microvolts, VDD is from the 5V@1A5 SMPS supply (^1 is hacked to input from USB)
+uint32_t ref_intern_1v0; // microvolts, 1V024 +/- 4%, but a bandgap refernace is temperature stable
+uint32_t ref_intern_2v0; // microvolts, 2V048 +/- 4%, but a bandgap refernace is temperature stable
+uint32_t ref_intern_4v1; // microvolts, 4V096 +/- 4%, but a bandgap refernace is temperature stable
 
 struct AdcConf_Map adcConfMap[ADC_CHANNELS]; // Array of ADC config struct. The header has the struct 
 
-// TODO: load referances from manager over I2C
+struct Adc_Cal_Record adc_cal; // the record that was loaded, /cal changes it and can save it
+uint8_t adc_cal_source; // ADC_CAL_SOURCE_t
+
+// reference each ADC_REF_t selects
+static uint32_t * const ref_value[ADC_REFS] = {&ref_extern_vdd, &ref_intern_1v0, &ref_intern_2v0, &ref_intern_4v1};
+static const uint8_t ref_sel[ADC_REFS] PROGMEM = {VREF_REFSEL_VDD_gc, VREF_REFSEL_1V024_gc, VREF_REFSEL_2V048_gc, VREF_REFSEL_4V096_gc};
+
+// named inputs (ADC_INPUT_t) and their MUXPOS, MUXNEG settings
+const char adc_input_tokens[] PROGMEM = "ain0\0ain1\0ain2\0ain3\0ain4\0ain5\0ain6\0ain7\0d01\0d23\0d45\0d67\0temp\0dac0\0dacref0\0dacref1\0dacref2\0gnd\0";
+static const uint8_t input_mux[ADC_INPUTS][2] PROGMEM = {
+    {ADC_MUXPOS_AIN0_gc, ADC_MUXNEG_GND_gc}, {ADC_MUXPOS_AIN1_gc, ADC_MUXNEG_GND_gc},
+    {ADC_MUXPOS_AIN2_gc, ADC_MUXNEG_GND_gc}, {ADC_MUXPOS_AIN3_gc, ADC_MUXNEG_GND_gc},
+    {ADC_MUXPOS_AIN4_gc, ADC_MUXNEG_GND_gc}, {ADC_MUXPOS_AIN5_gc, ADC_MUXNEG_GND_gc},
+    {ADC_MUXPOS_AIN6_gc, ADC_MUXNEG_GND_gc}, {ADC_MUXPOS_AIN7_gc, ADC_MUXNEG_GND_gc},
+    {ADC_MUXPOS_AIN0_gc, ADC_MUXNEG_AIN1_gc}, {ADC_MUXPOS_AIN2_gc, ADC_MUXNEG_AIN3_gc},
+    {ADC_MUXPOS_AIN4_gc, ADC_MUXNEG_AIN5_gc}, {ADC_MUXPOS_AIN6_gc, ADC_MUXNEG_AIN7_gc},
+    {ADC_MUXPOS_TEMPSENSE_gc, ADC_MUXNEG_GND_gc}, {ADC_MUXPOS_DAC0_gc, ADC_MUXNEG_GND_gc},
+    {ADC_MUXPOS_DACREF0_gc, ADC_MUXNEG_GND_gc}, {ADC_MUXPOS_DACREF1_gc, ADC_MUXNEG_GND_gc},
+    {ADC_MUXPOS_DACREF2_gc, ADC_MUXNEG_GND_gc}, {ADC_MUXPOS_GND_gc, ADC_MUXNEG_GND_gc}
+};
+
+// ADC_UNIT_t names
+const char adc_unit_tokens[] PROGMEM = "V\0Vd\0C\0";
+
+// the record has to fit in its EEPROM space (see ee_map.h)
+typedef char cal_record_fits[(sizeof(struct Adc_Cal_Record) <= EE_CAL_SIZE) ? 1 : -1];
+
+// the record without the crc
+#define CAL_CRC_SIZE (sizeof(struct Adc_Cal_Record) - sizeof(uint16_t))
+
+static uint16_t cal_crc(void)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t *p = (uint8_t *) &adc_cal;
+    for (uint8_t i = 0; i < CAL_CRC_SIZE; i++)
+    {
+        crc = _crc16_update(crc, p[i]);
+    }
+    return crc;
+}
+
+// defaults are channels AIN0..AIN7 to GND with VDD as the reference and no trim
+void adc_cal_defaults(void)
+{
+    adc_cal_source = ADC_CAL_DEFAULT;
+    adc_cal.version = ADC_CAL_VERSION;
+    adc_cal.ref_uv[ADC_REF_VDD] = 5000000UL; // VDD is from the 5V@1A5 SMPS supply
+    adc_cal.ref_uv[ADC_REF_1V024] = 1024000UL;
+    adc_cal.ref_uv[ADC_REF_2V048] = 2048000UL;
+    adc_cal.ref_uv[ADC_REF_4V096] = 4096000UL;
+    for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+    {
+        adc_cal.ch[ch].gain = ADC_GAIN_ONE;
+        adc_cal.ch[ch].offset = 0;
+        adc_cal.ch[ch].ref = ADC_REF_VDD;
+        adc_cal.ch[ch].muxpos = ADC_MUXPOS_AIN0_gc + ch;
+        adc_cal.ch[ch].muxneg = ADC_MUXNEG_GND_gc;
+        adc_cal.ch[ch].sampctrl = 0;
+    }
+}
+
+// read the record from EEPROM, returns 0 (and the record is not usable) if it is erased, 
+// from another version, or the CRC does not match
+uint8_t adc_cal_load(void)
+{
+    uint8_t *p = (uint8_t *) &adc_cal;
+    for (uint8_t i = 0; i < sizeof(struct Adc_Cal_Record); i++)
+    {
+        p[i] = eeprom_read_byte( (uint8_t *) (EE_CAL_ADDR + i) );
+    }
+    if ( (adc_cal.version != ADC_CAL_VERSION) || (adc_cal.crc != cal_crc()) ) return 0;
+    adc_cal_source = ADC_CAL_EEPROM;
+    return 1;
+}
+
+// write the record to EEPROM with its CRC, only bytes that change are written (it is rated for 100k write cycles)
+void adc_cal_save(void)
+{
+    adc_cal.version = ADC_CAL_VERSION;
+    adc_cal.crc = cal_crc();
+    uint8_t *p = (uint8_t *) &adc_cal;
+    for (uint8_t i = 0; i < sizeof(struct Adc_Cal_Record); i++)
+    {
+        if (eeprom_read_byte( (uint8_t *) (EE_CAL_ADDR + i) ) != p[i])
+        {
+            eeprom_write_byte( (uint8_t *) (EE_CAL_ADDR + i), p[i]);
+        }
+    }
+    adc_cal_source = ADC_CAL_EEPROM;
+}
+
+// put the record in the references and channel settings, the accumulation (/acc) is not part of it
+void adc_cal_apply(void)
+{
+    for (uint8_t r = 0; r < ADC_REFS; r++)
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            *ref_value[r] = adc_cal.ref_uv[r];
+        }
+    }
+    for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+    {
+        struct Adc_Cal_Ch *cal = &adc_cal.ch[ch];
+        uint8_t ref = (cal->ref < ADC_REFS) ? cal->ref : ADC_REF_VDD;
+        // the ISR reads the settings when it selects the channel
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            adcConfMap[ch].gain = cal->gain;
+            adcConfMap[ch].offset = cal->offset;
+            adcConfMap[ch].ref = ref_value[ref];
+            adcConfMap[ch].adc0ref = (VREF_REFSEL_t) pgm_read_byte(&ref_sel[ref]);
+            adcConfMap[ch].muxpos = (ADC_MUXPOS_t) cal->muxpos;
+            adcConfMap[ch].muxneg = (ADC_MUXNEG_t) cal->muxneg;
+            adcConfMap[ch].sampctrl = cal->sampctrl;
+            adcConfMap[ch].convmode = (cal->muxneg != ADC_MUXNEG_GND_gc) ? ADC_CONVMODE_bm : 0;
+            if (adcConfMap[ch].convmode)
+            {
+                adcConfMap[ch].unit = ADC_UNIT_DIFF_VOLTS;
+            }
+            else if (cal->muxpos == ADC_MUXPOS_TEMPSENSE_gc)
+            {
+                adcConfMap[ch].unit = ADC_UNIT_CELSIUS;
+            }
+            else
+            {
+                adcConfMap[ch].unit = ADC_UNIT_VOLTS;
+            }
+        }
+        adc_cal_update( (ADC_CH_t) ch);
+    }
+    adc_scan_plan_build(); // a reference or mux change can move a channel to another group
+}
+
+// set the mux of a channel in the record to a named input, the temperature sensor also gets 
+// the reference and sample time its factory calibration is for. Use adc_cal_apply() after.
+void adc_cal_input(ADC_CH_t ch, ADC_INPUT_t in)
+{
+    if (in >= ADC_INPUTS) return;
+    struct Adc_Cal_Ch *cal = &adc_cal.ch[ch];
+    cal->muxpos = pgm_read_byte(&input_mux[in][0]);
+    cal->muxneg = pgm_read_byte(&input_mux[in][1]);
+    if (in == ADC_IN_TEMP)
+    {
+        cal->ref = ADC_REF_2V048;
+        if (cal->sampctrl < ADC_TEMP_SAMPCTRL) cal->sampctrl = ADC_TEMP_SAMPCTRL;
+    }
+    adc_cal_source = ADC_CAL_CHANGED;
+}
+
+// named input that the mux of a channel selects, ADC_INPUTS if it is not one of them (e.g., set with /cal mux)
+ADC_INPUT_t adc_cal_input_of(ADC_CH_t ch)
+{
+    for (uint8_t in = 0; in < ADC_INPUTS; in++)
+    {
+        if ( (pgm_read_byte(&input_mux[in][0]) == adc_cal.ch[ch].muxpos) && 
+             (pgm_read_byte(&input_mux[in][1]) == adc_cal.ch[ch].muxneg) )
+        {
+            return (ADC_INPUT_t) in;
+        }
+    }
+    return ADC_INPUTS;
+}
+
+// load the references in one pass from the EEPROM calibration record, or the defaults if it is not usable
 VREF_LOADED_t LoadAnalogRef()
 {
-    uint16_t i2c_success = 1; // i2c will take several scan loops to finish
-    switch (ref_loaded)
+    if ( !adc_cal_load() ) adc_cal_defaults();
+    for (uint8_t r = 0; r < ADC_REFS; r++)
     {
-    case VREF_LOADED_NO:
-        ref_extern_vdd = 5.0;
-        if (i2c_success) ref_loaded = VREF_LOADED_VDD;
-        break;
-    case VREF_LOADED_VDD:
-        ref_intern_1v0 = 1.024;
-        if (i2c_success) ref_loaded = VREF_LOADED_1V0;
-        break;
-    case VREF_LOADED_1V0:
-        ref_intern_2v0 = 2.048;
-        if (i2c_success) ref_loaded = VREF_LOADED_2V0;
-        break;
-    case VREF_LOADED_2V0:
-        ref_intern_4v1 = 4.096;
-        if (i2c_success) ref_loaded = VREF_LOADED_4V1;
-        break;
-    case VREF_LOADED_4V1:
-        ref_loaded = VREF_LOADED_DONE;
-        break;
-    case VREF_LOADED_DONE:
-        break;
-    default:
-        case VREF_LOADED_ERR:
-        break;
+        *ref_value[r] = adc_cal.ref_uv[r];
     }
+    ref_loaded = VREF_LOADED_DONE;
     return ref_loaded;
 }
 
-// Load the hardware setting for ADC channel operation
-// TODO: load calibrations from manager over I2C
+// Load the hardware setting for ADC channel operation in one pass from the record LoadAnalogRef() got
 CALIBRATE_LOADED_t LoadAdcConfig()
 {
-    uint16_t i2c_success = 1; // i2c will take several scan loops to finish each cal. It is a place holder for the code.
-    ADC_CH_t ch; // channels may be differential or internal things (TEMPSENSE, DAC, REF0...)
-    switch (cal_loaded)
+    if (ref_loaded != VREF_LOADED_DONE)
     {
-    case CALIBRATE_LOADED_NO:
-        ch = ADC_CH_ADC0;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN0_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH0;
-        break;
-    case CALIBRATE_LOADED_CH0:
-        ch = ADC_CH_ADC1;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN1_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH1;
-        break;
-    case CALIBRATE_LOADED_CH1:
-        ch = ADC_CH_ADC2;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN2_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH2;
-        break;
-    case CALIBRATE_LOADED_CH2:
-        ch = ADC_CH_ADC3;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN3_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH3;
-        break;
-    case CALIBRATE_LOADED_CH3:
-        ch = ADC_CH_ADC4;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN4_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH4;
-        break;
-    case CALIBRATE_LOADED_CH4:
-        ch = ADC_CH_ADC5;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN5_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH5;
-        break;
-    case CALIBRATE_LOADED_CH5:
-        ch = ADC_CH_ADC6;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN6_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH6;
-        break;
-    case CALIBRATE_LOADED_CH6:
-        ch = ADC_CH_ADC7;
-        adcConfMap[ch].calibration = 1.0/4096;
-        adcConfMap[ch].ref = &ref_extern_vdd;
-        adcConfMap[ch].adc0ref = VREF_REFSEL_VDD_gc;
-        adcConfMap[ch].muxpos = ADC_MUXPOS_AIN7_gc;
-        adcConfMap[ch].muxneg = ADC_MUXNEG_GND_gc;
-        adcConfMap[ch].sampctrl = 0;
-        if (i2c_success) cal_loaded = CALIBRATE_LOADED_CH7;
-        break;
-    case CALIBRATE_LOADED_CH7:
-        cal_loaded = CALIBRATE_LOADED_DONE;
-        break;
-
-    default:
         cal_loaded = CALIBRATE_LOADED_ERR;
-        break;
+        return cal_loaded;
     }
-
+    for (uint8_t ch = ADC_CH_ADC0; ch < ADC_CHANNELS; ch++)
+    {
+        adcConfMap[ch].sampnum = ADC_SAMPNUM_NONE_gc;
+        adcConfMap[ch].bits = ADC_BITS;
+    }
+    adc_cal_apply();
+    cal_loaded = CALIBRATE_LOADED_DONE;
     return cal_loaded;
 }
+
+// microvolts for each count of the channel reading in Q24.8 from its reference, gain and width, 
+// call it after any of them change. The gain multiply is split so it fits in 32 bits, the Q8 step is 64 bits 
+// since a full scale of ADC_REF_UV_MAX with a gain near 2.0 is over 24 bits.
+void adc_cal_update(ADC_CH_t ch)
+{
+    uint32_t ref = *adcConfMap[ch].ref;
+    uint16_t gain = adcConfMap[ch].gain;
+    uint32_t full_scale = (ref >> 15) * gain + ( ( (ref & 0x7FFF) * gain + 0x4000) >> 15);
+    uint8_t bits = adcConfMap[ch].bits - (adcConfMap[ch].convmode ? 1 : 0); // a differential reading is signed, VREF is half its span
+    uint32_t lsb_q8 = (uint32_t)( ( ( (uint64_t) full_scale << 8) + (1UL << (bits - 1)) ) >> bits);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adcConfMap[ch].lsb_q8 = lsb_q8;
+    }
+}
+
+// calibrated microvolts of a channel reading, the offset is in 12 bit counts and scaled to the reading width. 
+// The multiply is 64 bits, a differential reading with the most offset and gain is over 32 bits before the shift.
+int32_t adc_microvolts(ADC_CH_t ch, int32_t reading)
+{
+    int32_t value = reading + ( (int32_t) adcConfMap[ch].offset << (adcConfMap[ch].bits - ADC_BITS) );
+    uint8_t negative = (value < 0);
+    uint32_t magnitude = negative ? (0 - (uint32_t) value) : (uint32_t) value;
+    uint32_t uv = (uint32_t)( ( (uint64_t) magnitude * adcConfMap[ch].lsb_q8 + 0x80) >> 8);
+    return negative ? -((int32_t) uv) : (int32_t) uv;
+}
+
+// reading in millionths of the channel unit, microvolts or for the temperature sensor micro degrees C. 
+// The sensor reading is taken to 12 bits for the SIGROW calibration, kelvin = (TEMPSENSE1 - reading) * TEMPSENSE0 / 4096
+int32_t adc_micro_units(ADC_CH_t ch, int32_t reading)
+{
+    if (adcConfMap[ch].unit != ADC_UNIT_CELSIUS) return adc_microvolts(ch, reading);
+    uint8_t shift = adcConfMap[ch].bits - ADC_BITS;
+    int32_t reading12 = ( (reading + ( (1L << shift) >> 1) ) >> shift) + adcConfMap[ch].offset;
+    int32_t kelvin_q12 = ( (int32_t) SIGROW.TEMPSENSE1 - reading12) * (int32_t) SIGROW.TEMPSENSE0;
+    int32_t millikelvin = (kelvin_q12 * 1000L + 0x800) >> 12; // fits for a sensor under 500K
+    return (millikelvin - 273150L) * 1000L;
+}
@@ -4,10 +4,6 @@
 typedef enum VREF_LOADED_enum
 {
     VREF_LOADED_NO,  // not loaded and not started
-    VREF_LOADED_VDD,  // work in prcess, VDD loaded
-    VREF_LOADED_1V0,  // work in prcess, 1V0 loaded
-    VREF_LOADED_2V0,  // work in prcess, 2V0 loaded
-    VREF_LOADED_4V1,  // work in prcess, 4V1 loaded
     VREF_LOADED_DONE,  // references loaded
     VREF_LOADED_ERR  // Fail to load referances
 } VREF_LOADED_t;
@@ -15,38 +11,122 @@ typedef enum VREF_LOADED_enum
 typedef enum CALIBRATE_LOADED_enum
 {
     CALIBRATE_LOADED_NO,  // not loaded and not started
-    CALIBRATE_LOADED_CH0,  // work in prcess, load channel 0 and set reference
-    CALIBRATE_LOADED_CH1,  // work in prcess, load channel 1 and set reference
-    CALIBRATE_LOADED_CH2,  // work in prcess, load channel 2 and set reference
-    CALIBRATE_LOADED_CH3,  // work in prcess, load channel 3 and set reference
-    CALIBRATE_LOADED_CH4,  // work in prcess, load channel 4 and set reference
-    CALIBRATE_LOADED_CH5,  // work in prcess, load channel 5 and set reference
-    CALIBRATE_LOADED_CH6,  // work in prcess, load channel 6 and set reference
-    CALIBRATE_LOADED_CH7,  // work in prcess, load channel 7 and set reference
     CALIBRATE_LOADED_DONE,  // calibrations loaded and references set
     CALIBRATE_LOADED_ERR  // Fail to load calibrations
 } CALIBRATE_LOADED_t;
 
 extern VREF_LOADED_t ref_loaded;
-extern float ref_extern_vdd;
-extern float ref_intern_1v0;
-extern float ref_intern_2v0;
-extern float ref_intern_4v1;
+// references are in microvolts
+extern uint32_t ref_extern_vdd;
+extern uint32_t ref_intern_1v0;
+extern uint32_t ref_intern_2v0;
+extern uint32_t ref_intern_4v1;
+
+// gain is Q1.15 so it can trim from 0 to almost 2
+#define ADC_GAIN_ONE 0x8000
+#define ADC_OFFSET_MAX 2047
+#define ADC_REF_UV_MAX 5500000L // a reference can not be over VDD, and VDD is at most 5.5V
 
 extern CALIBRATE_LOADED_t cal_loaded;
 
+// what a channel reading is, it follows from the mux setting (see adc_cal_apply)
+typedef enum ADC_UNIT_enum
+{
+    ADC_UNIT_VOLTS, // single ended, 0..VREF
+    ADC_UNIT_DIFF_VOLTS, // differential (MUXNEG is not GND), a signed reading of -VREF..VREF
+    ADC_UNIT_CELSIUS // the temperature sensor, from the factory calibration in SIGROW
+} ADC_UNIT_t;
+
+// named inputs a channel can select (see /in), the mux settings and token list are in references.c
+typedef enum ADC_INPUT_enum
+{
+    ADC_IN_AIN0, // AIN0..AIN7 to GND
+    ADC_IN_D01 = 8, // AIN0 - AIN1 differential
+    ADC_IN_D23, // AIN2 - AIN3
+    ADC_IN_D45, // AIN4 - AIN5
+    ADC_IN_D67, // AIN6 - AIN7
+    ADC_IN_TEMP, // temperature sensor, needs the 2V048 reference and a long sample time
+    ADC_IN_DAC0, // DAC0 output
+    ADC_IN_DACREF0, // the DAC reference of each analog comparator
+    ADC_IN_DACREF1,
+    ADC_IN_DACREF2,
+    ADC_IN_GND, // an offset reading
+    ADC_INPUTS // the mux setting is not one of the named inputs
+} ADC_INPUT_t;
+
+// the temperature sensor is only calibrated for a 12 bit reading of at least 32 usec with the 2V048 reference
+#define ADC_TEMP_SAMPCTRL 32
+
+extern const char adc_input_tokens[];
+extern const char adc_unit_tokens[];
+
 struct AdcConf_Map { 
-    float calibration; // calibrated value need for an ADC divion of the channel.
-    float *ref; // pointer to the referance value used for channel
+    uint16_t gain; // Q1.15 trim of the full scale, ADC_GAIN_ONE is no trim
+    int16_t offset; // counts of a 12 bit reading added before the gain, +/- ADC_OFFSET_MAX
+    uint32_t *ref; // pointer to the referance (microvolts) used for channel
+    uint32_t lsb_q8; // microvolts per count of the reading in Q24.8 (see adc_cal_update)
     VREF_REFSEL_t adc0ref; // Setting for ADC0 Reference register
     ADC_MUXPOS_t muxpos; // Setting for ADC0 Positive mux input register
     ADC_MUXNEG_t muxneg; // Setting for ADC0 Negative mux input register
     uint8_t sampctrl; // Extend the ADC sampling time beyond the default two clocks
+    ADC_SAMPNUM_t sampnum; // Setting for ADC0 CTRLB, samples accumulated in hardware for one reading
+    uint8_t bits; // width of the reading ADC_BITS..ADC_BITS_MAX, e.g., ACC16 decimated to 14 bits (offset is for 12 bits)
+    uint8_t convmode; // ADC_CONVMODE_bm for a differential reading (ADC0.CTRLA), else 0
+    uint8_t unit; // ADC_UNIT_t
 };
 
 extern struct AdcConf_Map adcConfMap[]; // size is ADC_CHANNELS
 
+// references a channel can select in the calibration record
+typedef enum ADC_REF_enum
+{
+    ADC_REF_VDD,
+    ADC_REF_1V024,
+    ADC_REF_2V048,
+    ADC_REF_4V096,
+    ADC_REFS
+} ADC_REF_t;
+
+// calibration record kept in EEPROM (EE_CAL_ADDR), it has a version and a CRC16 so an erased or 
+// old record is not used (the defaults are)
+#define ADC_CAL_VERSION 1
+
+struct Adc_Cal_Ch {
+    uint16_t gain; // Q1.15
+    int16_t offset; // 12 bit counts
+    uint8_t ref; // ADC_REF_t
+    uint8_t muxpos;
+    uint8_t muxneg;
+    uint8_t sampctrl;
+};
+
+struct Adc_Cal_Record {
+    uint8_t version;
+    uint32_t ref_uv[ADC_REFS]; // measured references (microvolts)
+    struct Adc_Cal_Ch ch[ADC_CHANNELS];
+    uint16_t crc; // CRC16 (poly 0xA001, init 0xFFFF) of the bytes before it
+};
+
+typedef enum ADC_CAL_SOURCE_enum
+{
+    ADC_CAL_DEFAULT, // the EEPROM record was not usable
+    ADC_CAL_EEPROM, // the record in use is the saved one
+    ADC_CAL_CHANGED // changed since it was loaded or saved
+} ADC_CAL_SOURCE_t;
+
+extern struct Adc_Cal_Record adc_cal;
+extern uint8_t adc_cal_source;
+extern void adc_cal_defaults(void);
+extern uint8_t adc_cal_load(void);
+extern void adc_cal_save(void);
+extern void adc_cal_apply(void);
+extern void adc_cal_input(ADC_CH_t ch, ADC_INPUT_t in);
+extern ADC_INPUT_t adc_cal_input_of(ADC_CH_t ch);
+
 extern VREF_LOADED_t LoadAnalogRef();
 extern CALIBRATE_LOADED_t LoadAdcConfig();
+extern void adc_cal_update(ADC_CH_t ch);
+extern int32_t adc_microvolts(ADC_CH_t ch, int32_t reading);
+extern int32_t adc_micro_units(ADC_CH_t ch, int32_t reading);
 
 #endif // Analog_H 
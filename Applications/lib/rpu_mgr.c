@@ -354,7 +354,7 @@ void i2c_shutdown_cmd(uint8_t hs_callback_addr, uint8_t hs_callback_route, uint8
 // 21 .. DAYNIGHT_UL_CMD and DAYNIGHT_[MORNING_DEBOUNCE|EVENING_DEBOUNCE|...PWR_MTI_DAY]
 unsigned long i2c_ul_rwoff_access_cmd(uint8_t command, uint8_t rw_offset, unsigned long update_with, TWI0_LOOP_STATE_t *loop_state)
 {
-    if ( !((command == SHUTDOWN_UL_CMD) | (command == BATTERY_UL_CMD) | (command == DAYNIGHT_UL_CMD)) ) 
+    if ( !((command == SHUTDOWN_UL_CMD) | (command == BATTERY_UL_CMD) | (command == DAYNIGHT_UL_CMD) | (command == ENERGY_UL_CMD)) ) 
     {
         mgr_twiErrorCode = 6;
         *loop_state = TWI0_LOOP_STATE_DONE;
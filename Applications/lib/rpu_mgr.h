@@ -56,6 +56,17 @@ float i2c_float_access_cmd(uint8_t command, uint8_t select, float *update_with,
 #define DAYNIGHT_PWR_MTI_DAY 8 /* (accumulation of PWR_I readings every 10mSec / 10**6) at day event */
 #define BATTERY_UL_CMD 18
 #define BATTERY_CHARGE_PWM 0 /*offset to access alt_pwm_accum_charge_time*/
+#define ENERGY_UL_CMD 24 /* a write sets the accumulation and returns what it was, e.g., write zero to read and clear */
+#define ENERGY_ALT_MAS 0 /* ALT_I integrated every 10mSec in mA*Sec */
+#define ENERGY_ALT_MWS 1 /* ALT_I*ALT_V integrated every 10mSec in mW*Sec */
+#define ENERGY_PWR_MAS 2 /* PWR_I integrated every 10mSec in mA*Sec */
+#define ENERGY_PWR_MWS 3 /* PWR_I*PWR_V integrated every 10mSec in mW*Sec */
+#define ENERGY_SAMPLES 4 /* periods integrated */
+#define ENERGY_MISSED 5 /* periods where the manager ADC burst had not finished */
+#define ENERGY_ALT_MAS_HI 8 /* high 32 bits, latched when the low word (offset 0..3) is read, a write stages them for the next low word write */
+#define ENERGY_ALT_MWS_HI 9
+#define ENERGY_PWR_MAS_HI 10
+#define ENERGY_PWR_MWS_HI 11
 
 // values used for i2c_int_rwoff_access_cmd
 #define SHUTDOWN_INT_CMD 5
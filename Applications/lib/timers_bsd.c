@@ -254,6 +254,21 @@ unsigned long tickAtomic()
     return local;
 }
 
+#ifdef USE_TIMERA0
+// tick with the TCA0 high count below it, for time stamps finer than a tick (it rolls over after 2^24 ticks).
+// Call it with interrupts off (e.g., from an ISR).
+unsigned long ticksFine()
+{
+    unsigned long local = tick;
+    uint8_t count = TCA0.SPLIT.HCNT; // counts down from HPER
+    if ( (TCA0.SPLIT.INTFLAGS & TCA_SPLIT_HUNF_bm) && (count > 0x7F) )
+    {
+        local++; // it underflowed but the tick ISR has not counted it yet
+    }
+    return (local << 8) | (uint8_t)(0xFF - count);
+}
+#endif
+
 // convert up to 4 million milliseconds (1hr) to ticks
 unsigned long cnvrt_milli(unsigned long millisec)
 {
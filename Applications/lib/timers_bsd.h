@@ -15,3 +15,15 @@ unsigned long elapsed(unsigned long *past);
 unsigned long cnvrt_milli(unsigned long millisec);
 unsigned long cnvrt_milli_lrg(unsigned long millisec);
 
+#ifdef USE_TIMERA0
+// ticksFine() counts in units of the TCA0 prescaler (F_CPU clocks), e.g., 4 microseconds at 16MHz
+#if (F_CPU > 5000000)
+#define TICK_FINE_CLOCKS 64
+#elif (F_CPU > 1000000)
+#define TICK_FINE_CLOCKS 16
+#else
+#define TICK_FINE_CLOCKS 8
+#endif
+extern unsigned long ticksFine(void);
+#endif
+
@@ -134,6 +134,13 @@ bool uart0_availableForWrite(void)
     return (TxHead == TxTail);
 }
 
+// Number of bytes that can be written to the transmit buffer without blocking.
+// One slot of the ring is always left empty, so an empty buffer has (TX0_SIZE - 1).
+uint8_t uart0_availableForWriteBytes(void)
+{
+    return (TX0_SIZE - 1) - ( (TX0_SIZE + TxHead - TxTail) & ( TX0_SIZE - 1) );
+}
+
 // Protofunctions (code is latter) to allow UART0 to be used as a stream for printf, scanf, etc...
 int uart0_putchar(char c, FILE *stream);
 int uart0_getchar(FILE *stream);
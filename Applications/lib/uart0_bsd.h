@@ -27,6 +27,7 @@ extern void uart0_flush(void);
 extern void uart0_empty(void);
 extern int uart0_available(void);
 extern bool uart0_availableForWrite(void);
+extern uint8_t uart0_availableForWriteBytes(void);
 extern FILE *uart0_init(uint32_t baudrate, uint8_t choices);
 extern int uart0_putchar(char c, FILE *stream);
 extern int uart0_getchar(FILE *stream);
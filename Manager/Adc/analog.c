@@ -29,11 +29,18 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 #include "../lib/timers_bsd.h"
 #include "../lib/uart1_bsd.h"
 #include "../lib/references.h"
+#include "../lib/energy_bsd.h"
+#include "../lib/twi.h"
 #include "analog.h"
+#include "energy.h"
 
 static unsigned long serial_print_started_at;
 
 static uint8_t adc_ch;
+static uint8_t energy_accum;
+
+// JSON keys of the accumulations
+static const char energy_keys[ENERGY_ACCUMS][8] PROGMEM = {"ALT_mAs", "ALT_mWs", "PWR_mAs", "PWR_mWs"};
 
 static uint8_t debug_print_step = 0;
 
@@ -75,8 +82,9 @@ uint8_t adc_to_json(FILE *__stream, unsigned long serial_print_delay_ticks)
 
         if ( (adc_ch+1) >= ADC_CHANNELS) 
         {
-            fprintf_P(__stream, PSTR("}\r\n"));
-            debug_print_step = 3;
+            fprintf_P(__stream, PSTR(","));
+            energy_accum = ENERGY_ALT_CHARGE;
+            debug_print_step = 4;
         }
         else
         {
@@ -93,5 +101,26 @@ uint8_t adc_to_json(FILE *__stream, unsigned long serial_print_delay_ticks)
             debug_print_step = 0; /* This keeps looping debug output forever */
         }
     }
+    else if ( (debug_print_step == 4) )
+    { // accumulations follow the channels
+        fprintf_P(__stream, PSTR("\"%S\":"), energy_keys[energy_accum]);
+        debug_print_step = 5;
+    }
+    else if ( (debug_print_step == 5) )
+    {
+        fprint_energy(__stream, (ENERGY_ACCUM_t) energy_accum);
+
+        if ( (energy_accum+1) >= ENERGY_ACCUMS) 
+        {
+            fprintf_P(__stream, PSTR("}\r\n"));
+            debug_print_step = 3;
+        }
+        else
+        {
+            fprintf_P(__stream, PSTR(","));
+            energy_accum++;
+            debug_print_step = 4;
+        }
+    }
     return 1;
 }
@@ -0,0 +1,165 @@
+/*
+energy gives the accumulations of the manager ADC channels to the application over I2C and to uart1
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "../lib/twi.h"
+#include "../lib/energy_bsd.h"
+#include "energy.h"
+
+static uint8_t twi_buf[UL_RW_ARRY_CMD_SIZE]; // command from the master, then the reply
+static uint8_t twi_count; // bytes received, or bytes sent when the master reads
+static uint8_t twi_reading; // master is reading
+
+static uint32_t hi_latch[ENERGY_ACCUMS]; // high word of the last low word read (or replaced)
+static uint32_t hi_stage[ENERGY_ACCUMS]; // high word for the next low word write
+
+// Run the command in twi_buf and put the reply there. It runs in the ISR, so the counts can not change while they are copied.
+// An accumulation is 64 bits in milli units*Sec. Reading the low word latches the high word for its _HI offset, so the
+// two reads go together. A write to _HI stages the high word, then a write to the low word sets the accumulation and
+// the reply has the low word it had (its high word is latched), so writing zero reads and clears it.
+static bool energy_ul_cmd(void)
+{
+    if ( (twi_count != UL_RW_ARRY_CMD_SIZE) || (twi_buf[0] != ENERGY_UL_CMD) ) return false;
+    uint8_t offset = twi_buf[1] & ~RW_WRITE_BIT;
+    unsigned long update = ((unsigned long)twi_buf[2])<<24;
+    update += ((unsigned long)twi_buf[3])<<16;
+    update += ((unsigned long)twi_buf[4])<<8;
+    update += (unsigned long)twi_buf[5];
+    unsigned long value;
+    if (offset < ENERGY_ACCUMS)
+    {
+        int64_t accum;
+        if (twi_buf[1] & RW_WRITE_BIT)
+        {
+            uint64_t milli = ((uint64_t)hi_stage[offset] << 32) | update;
+            hi_stage[offset] = 0;
+            accum = energy_swap((ENERGY_ACCUM_t)offset, (int64_t)milli * 1000000);
+        }
+        else
+        {
+            accum = energy_take((ENERGY_ACCUM_t)offset);
+        }
+        uint64_t milli = (uint64_t)(accum / 1000000); // micro units*mSec to milli units*Sec
+        hi_latch[offset] = (uint32_t)(milli >> 32);
+        value = (unsigned long)milli;
+    }
+    else if ( (offset >= ENERGY_HI_OFFSET) && (offset < (ENERGY_HI_OFFSET + ENERGY_ACCUMS)) )
+    {
+        uint8_t accum = offset - ENERGY_HI_OFFSET;
+        if (twi_buf[1] & RW_WRITE_BIT) hi_stage[accum] = update;
+        value = hi_latch[accum];
+    }
+    else if (offset == ENERGY_SAMPLES)
+    {
+        value = energy_samples;
+    }
+    else if (offset == ENERGY_MISSED)
+    {
+        value = energy_missed;
+    }
+    else
+    {
+        return false;
+    }
+    twi_buf[2] = (uint8_t)((value & 0xFF000000UL)>>24);
+    twi_buf[3] = (uint8_t)((value & 0xFF0000UL)>>16);
+    twi_buf[4] = (uint8_t)((value & 0xFF00UL)>>8);
+    twi_buf[5] = (uint8_t)(value & 0xFFUL);
+    twi_buf[6] = 0;
+    return true;
+}
+
+// TWI1 slave callback (ISR context), the master writes a UL command and then reads the reply after a repeated start
+bool energy_twi1s_callback(twis_irqstate_t state, uint8_t statusReg)
+{
+    bool ret = true;
+    switch (state)
+    {
+        case TWIS_ADDRESSED:
+            if (twi1s_lastAddress() != I2C_ADDR_OF_BUS_MGR)
+            {
+                ret = false; // general call is not for us
+            }
+            else if (statusReg & TWI_DIR_bm)
+            {
+                ret = energy_ul_cmd();
+                twi_reading = 1;
+                twi_count = 0;
+            }
+            else
+            {
+                twi_reading = 0;
+                twi_count = 0;
+            }
+            break;
+        case TWIS_MWRITE:
+            if (twi_count < UL_RW_ARRY_CMD_SIZE)
+            {
+                twi_buf[twi_count++] = twi1s_read();
+            }
+            else
+            {
+                ret = false;
+            }
+            break;
+        case TWIS_MREAD:
+            if (twi_count < UL_RW_ARRY_CMD_SIZE)
+            {
+                twi1s_write(twi_buf[twi_count++]);
+            }
+            else
+            {
+                ret = false;
+            }
+            break;
+        case TWIS_STOPPED:
+            if (!twi_reading) energy_ul_cmd(); // a write without a read still updates
+            twi_count = 0;
+            ret = false;
+            break;
+        case TWIS_ERROR:
+            twi_count = 0;
+            ret = false;
+            break;
+    }
+    return ret;
+}
+
+// print an accumulator, in micro units*mSec, as a JSON string in milli units*Sec with three decimals
+void fprint_energy(FILE *__stream, ENERGY_ACCUM_t accum)
+{
+    int64_t value = energy_take(accum);
+    uint8_t negative = (value < 0);
+    uint64_t magnitude = negative ? (0 - (uint64_t)value) : (uint64_t)value;
+    magnitude /= 1000;
+    uint64_t whole = magnitude / 1000;
+    unsigned int part = (unsigned int)(magnitude % 1000);
+    // avr-libc printf does not do 64 bits, so the whole part goes out as two groups when it is past 32 bits
+    unsigned long upper = (unsigned long)(whole / 1000000000);
+    unsigned long lower = (unsigned long)(whole % 1000000000);
+    if (upper)
+    {
+        fprintf_P(__stream, PSTR("\"%s%lu%09lu.%03u\""), negative ? "-" : "", upper, lower, part);
+    }
+    else
+    {
+        fprintf_P(__stream, PSTR("\"%s%lu.%03u\""), negative ? "-" : "", lower, part);
+    }
+}
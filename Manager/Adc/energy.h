@@ -0,0 +1,28 @@
+#ifndef Energy_Cmd_H
+#define Energy_Cmd_H
+
+// the manager address on the private I2C bus (TWI1) with the application
+#define I2C_ADDR_OF_BUS_MGR 0x29
+
+// UL commands are [command, rw_offset, four bytes of an unsigned long (MSB first), 0]
+#define UL_RW_ARRY_CMD_SIZE 7
+#define RW_WRITE_BIT 0x80
+
+// values used for ENERGY_UL_CMD, the offset is an ENERGY_ACCUM_enum for the first four (their low 32 bits)
+#define ENERGY_UL_CMD 24
+#define ENERGY_ALT_MAS 0 /* ALT_I charge in mA*Sec */
+#define ENERGY_ALT_MWS 1 /* ALT_I*ALT_V energy in mW*Sec */
+#define ENERGY_PWR_MAS 2 /* PWR_I charge in mA*Sec */
+#define ENERGY_PWR_MWS 3 /* PWR_I*PWR_V energy in mW*Sec */
+#define ENERGY_SAMPLES 4 /* periods integrated */
+#define ENERGY_MISSED 5 /* periods where the burst had not finished */
+#define ENERGY_HI_OFFSET 8 /* add to 0..3 for the high word, latched when the low word is read */
+#define ENERGY_ALT_MAS_HI 8
+#define ENERGY_ALT_MWS_HI 9
+#define ENERGY_PWR_MAS_HI 10
+#define ENERGY_PWR_MWS_HI 11
+
+extern bool energy_twi1s_callback(twis_irqstate_t state, uint8_t statusReg);
+extern void fprint_energy(FILE *__stream, ENERGY_ACCUM_t accum);
+
+#endif // Energy_Cmd_H
@@ -25,10 +25,9 @@ https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%
 #include "../lib/adc_bsd.h"
 #include "../lib/twi.h"
 #include "../lib/io_enum_bsd.h"
+#include "../lib/energy_bsd.h"
 #include "analog.h"
-
-#define ADC_DELAY_MILSEC 200UL
-static unsigned long adc_started_at;
+#include "energy.h"
 
 #define BLINK_DELAY 1000UL
 static unsigned long blink_started_at;
@@ -79,9 +78,8 @@ void setup(void)
     // initialize ADC but do not start it.
     init_ADC_single_conversion();
 
-    // put ADC in Auto Trigger mode and fetch an array of channels
-    enable_ADC_auto_conversion(BURST_MODE);
-    adc_started_at = milliseconds();
+    // TCB0 starts an ADC burst every ENERGY_PERIOD_MILSEC and integrates the readings
+    energy_start();
 
     /* Initialize UART to 38.4kbps, it returns a pointer to FILE so redirect of stdin and stdout works*/
     uart1 = uart1_init(38400UL, UART1_RX_REPLACE_CR_WITH_NL);
@@ -89,6 +87,7 @@ void setup(void)
     /* I2C will be used after some iterations*/
     twim_altPins(); // tell twi0 hardware to use pins PC2, PC3 with MVIO. They go to the R-Pi host
     twi1m_defaultPins(); // tell twi1 hardware to use pins PF2, PF3. They go to the Appliction MCU (e.g., the AVR128DA28)
+    twi1s_init(I2C_ADDR_OF_BUS_MGR, energy_twi1s_callback); // the application reads the accumulations with ENERGY_UL_CMD
 
     // Enable global interrupts to start TIMER0 and UART ISR's
     sei(); 
@@ -111,16 +110,6 @@ void blink(void)
     }
 }
 
-void adc_burst(void)
-{
-    unsigned long kRuntime= elapsed(&adc_started_at);
-    if ((kRuntime) > ((unsigned long)ADC_DELAY_MILSEC))
-    {
-        enable_ADC_auto_conversion(BURST_MODE);
-        adc_started_at += ADC_DELAY_MILSEC; 
-    } 
-}
-
 // abort++. 
 void abort_safe(void)
 {
@@ -187,9 +176,6 @@ int main(void)
             blink(); // also ping_i2c1() at the toggle event
         }
 
-        // delay between ADC burst
-        adc_burst();
-          
         // print adc json if stram is available for write
         if ( uart1_availableForWrite() ) {
             if (!adc_to_json(uart1, 20000UL)) {
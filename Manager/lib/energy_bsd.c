@@ -0,0 +1,102 @@
+/*
+Energy accumulation of the manager ADC channels on a fixed timer
+Copyright (C) 2021 Ronald Sutherland
+
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby granted.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+https://en.wikipedia.org/wiki/BSD_licenses#0-clause_license_(%22Zero_Clause_BSD%22)
+
+TCB0 interrupts every ENERGY_PERIOD_MILSEC, the ISR integrates the last burst
+readings of ALT_I, ALT_V, PWR_I, and PWR_V then starts the next burst. Each
+reading is held for one period, so the integral is a rectangle sum that lags
+by one period.
+*/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "adc_bsd.h"
+#include "energy_bsd.h"
+
+static volatile int64_t energy_accum[ENERGY_ACCUMS];
+volatile uint32_t energy_samples;
+volatile uint32_t energy_missed;
+
+// add one period of current (and power) to the accumulators starting at charge
+static void energy_step(ENERGY_ACCUM_t charge, int i_counts, int v_counts, uint32_t ua_q8, uint32_t v_q24)
+{
+    uint32_t i_ua = ((uint32_t)i_counts * ua_q8) >> 8; // 4095 * 625000 fits in 32 bits
+    uint32_t v_q = (uint32_t)v_counts * v_q24; // volts * 2**24
+    uint64_t p_uw = ((uint64_t)i_ua * v_q) >> 24;
+    energy_accum[charge] += (int64_t)i_ua * ENERGY_PERIOD_MILSEC;
+    energy_accum[charge + 1] += (int64_t)p_uw * ENERGY_PERIOD_MILSEC;
+}
+
+ISR(TCB0_INT_vect)
+{
+    TCB0.INTFLAGS = TCB_CAPT_bm; // clear the flag
+
+    // adc[] has the last complete reading of each channel, a burst that did not finish still leaves the older ones
+    energy_step(ENERGY_ALT_CHARGE, adc[ADC_CH_ADC1], adc[ADC_CH_ADC2], ENERGY_ALT_I_UA_Q8, ENERGY_ALT_V_Q24);
+    energy_step(ENERGY_PWR_CHARGE, adc[ADC_CH_ADC3], adc[ADC_CH_ADC4], ENERGY_PWR_I_UA_Q8, ENERGY_PWR_V_Q24);
+    energy_samples++;
+
+    if (adc_isr_status == ISR_ADCBURST_DONE)
+    {
+        enable_ADC_auto_conversion(BURST_MODE);
+    }
+    else
+    {
+        energy_missed++;
+    }
+}
+
+// Use init_ADC_single_conversion and initTimers before this.
+// TCB0 in periodic interrupt mode is clocked from CLK_TCA and starts the bursts.
+void energy_start(void)
+{
+    TCB0.CTRLA = 0; // disabled
+    TCB0.CTRLB = TCB_CNTMODE_INT_gc;
+    TCB0.CCMP = ENERGY_TCB_TOP; // counts from 0 to TOP
+    TCB0.CNT = 0;
+    TCB0.INTFLAGS = TCB_CAPT_bm;
+    TCB0.INTCTRL = TCB_CAPT_bm;
+    enable_ADC_auto_conversion(BURST_MODE); // the first readings for the first period
+    TCB0.CTRLA = (TCB_CLKSEL_TCA0_gc) | (TCB_ENABLE_bm);
+}
+
+// copy an accumulator with an atomic transaction, the ISR can not change it durring the read
+int64_t energy_take(ENERGY_ACCUM_t accum)
+{
+    int64_t ret = 0;
+    if (accum < ENERGY_ACCUMS)
+    {
+        uint8_t oldSREG = SREG;
+        cli();
+        ret = energy_accum[accum];
+        SREG = oldSREG;
+    }
+    return ret;
+}
+
+// replace an accumulator (e.g., with zero) and return what it had, nothing is lost between the read and the write
+int64_t energy_swap(ENERGY_ACCUM_t accum, int64_t value)
+{
+    int64_t ret = 0;
+    if (accum < ENERGY_ACCUMS)
+    {
+        uint8_t oldSREG = SREG;
+        cli();
+        ret = energy_accum[accum];
+        energy_accum[accum] = value;
+        SREG = oldSREG;
+    }
+    return ret;
+}
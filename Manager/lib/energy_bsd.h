@@ -0,0 +1,45 @@
+#ifndef Energy_H
+#define Energy_H
+
+#include <stdint.h>
+
+// the ADC burst is started and the readings integrated on this period
+#define ENERGY_PERIOD_MILSEC 10UL
+
+// TCB0 is clocked from CLK_TCA, see the TCA0 prescaler in initTimers()
+#if (F_CPU > 5000000)
+#define ENERGY_CLK_TCA (F_CPU / 64)
+#elif (F_CPU > 1000000)
+#define ENERGY_CLK_TCA (F_CPU / 16)
+#else
+#define ENERGY_CLK_TCA (F_CPU / 8)
+#endif
+#define ENERGY_TCB_TOP ( (ENERGY_CLK_TCA / (1000UL / ENERGY_PERIOD_MILSEC)) - 1 )
+
+// board scaling of the readings with a 5V VDD reference and 4096 slots.
+// ALT_I: 0.01 Ohm sense with a gain of 50, 2441.406 uA per count as Q8 (uA * 256)
+// PWR_I: 0.068 Ohm sense with a gain of 50, 359.03 uA per count as Q8
+// ALT_V: 100k/10k divider, 0.013427734 V per count as Q24 (V * 2**24)
+// PWR_V: 100k/15.8k divider, 0.0089467 V per count as Q24
+#define ENERGY_ALT_I_UA_Q8 625000UL
+#define ENERGY_PWR_I_UA_Q8 91912UL
+#define ENERGY_ALT_V_Q24 225280UL
+#define ENERGY_PWR_V_Q24 150101UL
+
+// accumulators, charge is in uA*mSec (nA*Sec) and energy is in uW*mSec (nW*Sec)
+typedef enum ENERGY_ACCUM_enum {
+    ENERGY_ALT_CHARGE, // ALT_I integrated
+    ENERGY_ALT_ENERGY, // ALT_I * ALT_V integrated
+    ENERGY_PWR_CHARGE, // PWR_I integrated
+    ENERGY_PWR_ENERGY, // PWR_I * PWR_V integrated
+    ENERGY_ACCUMS
+} ENERGY_ACCUM_t;
+
+extern volatile uint32_t energy_samples; // periods integrated
+extern volatile uint32_t energy_missed; // periods where the last burst had not finished
+
+extern void energy_start(void);
+extern int64_t energy_take(ENERGY_ACCUM_t accum);
+extern int64_t energy_swap(ENERGY_ACCUM_t accum, int64_t value);
+
+#endif // Energy_H